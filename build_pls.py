@@ -4,15 +4,17 @@ import matplotlib.pyplot as plt
 df = pd.read_csv('search_times.csv')
 
 plt.figure()
-for col in ['linear_us','bst_us','rbt_us','hash_us','multimap_us']:
-    plt.plot(df['size'], df[col], label=col.split('_')[0])
+for name in ['linear','linear_col','linear_col_mt','bst','rbt','bst_fixed','rbt_fixed','hash','hash_wy','hash_grow','rbt_row','hash_row','flat','eytz','trie','multimap']:
+    plt.errorbar(df['size'], df[name + '_median_ns'], yerr=df[name + '_sd_ns'],
+                 label=name, capsize=2)
 plt.xscale('log'); plt.yscale('log')
-plt.xlabel('Размер массива'); plt.ylabel('Время поиска, мкс')
+plt.xlabel('Размер массива'); plt.ylabel('Время поиска (медиана), нс')
 plt.title('Сравнение алгоритмов поиска'); plt.grid(True, which='both')
 plt.legend(); plt.savefig('search_time_compare.png', dpi=200)
 
 plt.figure()
-plt.plot(df['size'], df['collisions'])
+for name in ['hash', 'hash_wy', 'flat']:
+    plt.plot(df['size'], df[name + '_collisions'], label=name)
 plt.xscale('log'); plt.xlabel('Размер массива')
 plt.ylabel('Колизии'); plt.title('Коллизии хеш-функции')
-plt.grid(True, which='both'); plt.savefig('hash_collisions.png', dpi=200)
\ No newline at end of file
+plt.grid(True, which='both'); plt.legend(); plt.savefig('hash_collisions.png', dpi=200)
\ No newline at end of file
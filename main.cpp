@@ -3,7 +3,9 @@
  * @brief Реализация различных алгоритмов поиска для объектов Passenger.
  * 
  * Включает линейный поиск, бинарное дерево поиска (BST), красно-чёрное дерево (RBTree),
- * хеш-таблицу с цепочками и сравнение с std::multimap.
+ * хеш-таблицу с цепочками, хеш-таблицу с открытой адресацией (FlatHashTable),
+ * хеш-таблицу с чтением без блокировок (ConcurrentHashTable),
+ * статический индекс в порядке Эйтцингера и сравнение с std::multimap.
  * Измеряется время поиска и количество коллизий для хеш-таблицы.
  * 
  * @author <Alsakh>
@@ -16,6 +18,48 @@
 #include <random>
 #include <fstream>
 #include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdexcept>
+#include <cmath>
+#include <limits>
+#include <charconv>
+#include <deque>
+#include <exception>
+#include <concepts>
+#include <optional>
+#include <ctime>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 /**
  * @struct Passenger
@@ -30,6 +74,181 @@ struct Passenger {
     std::string destinationPort;/**< Порт назначения */
 };
 
+/**
+ * @class View
+ * @brief Невладеющее представление непрерывного диапазона (аналог std::span).
+ *
+ * Индексы возвращают его из lookup() вместо копии списка пассажиров.
+ * Правила времени жизни те же, что у итераторов std::multimap::equal_range:
+ * вставка и удаление других ключей представление не портят, недействительным
+ * его делают изменение этого же ключа (insert, erase, update) и разрушение
+ * самого индекса.
+ *
+ * @tparam T Тип элемента.
+ */
+template<typename T>
+class View {
+    const T* first = nullptr;
+    const T* last  = nullptr;
+public:
+    View() = default;
+    View(const T* b, const T* e) : first(b), last(e) {}
+    template<typename C>
+    explicit View(const C& c) : first(c.data()), last(c.data() + c.size()) {}
+
+    const T* begin() const { return first; }
+    const T* end()   const { return last; }
+    size_t   size()  const { return static_cast<size_t>(last - first); }
+    bool     empty() const { return first == last; }
+    const T& operator[](size_t i) const { return first[i]; }
+};
+
+/** @brief Результат поиска: все пассажиры с данным ключом. */
+using PayloadView = View<const Passenger*>;
+
+/** @brief Номер строки в PassengerStore. */
+using RowId = uint32_t;
+
+/**
+ * @class ThreadPool
+ * @brief Пул рабочих потоков для параллельной обработки диапазона задач.
+ *
+ * Потоки создаются один раз и ждут задания на условной переменной.
+ * parallelFor() делит диапазон на непрерывные куски по числу потоков,
+ * вызывающий поток обрабатывает первый кусок сам. Вызовы пула
+ * из нескольких потоков одновременно не поддерживаются.
+ */
+class ThreadPool {
+    std::vector<std::thread>           workers;
+    std::mutex                         m;
+    std::condition_variable            wake;
+    std::condition_variable            done;
+    const std::function<void(size_t)>* job        = nullptr;
+    size_t                             generation = 0;
+    size_t                             pending    = 0;
+    bool                               stop       = false;
+
+    void loop(size_t id) {
+        size_t seen = 0;
+        while (true) {
+            std::unique_lock<std::mutex> lk(m);
+            wake.wait(lk, [&] { return stop || generation != seen; });
+            if (stop) return;
+            seen = generation;
+            const auto* j = job;
+            lk.unlock();
+            (*j)(id);
+            lk.lock();
+            if (--pending == 0) done.notify_one();
+        }
+    }
+public:
+    /** @param nThreads Общее число потоков, включая вызывающий (не меньше 1). */
+    explicit ThreadPool(size_t nThreads) {
+        for (size_t i = 1; i < nThreads; ++i) workers.emplace_back(&ThreadPool::loop, this, i);
+    }
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size() + 1; }
+
+    /** @brief Выполняет f(id) на каждом потоке пула, id в [0, size()). */
+    void run(const std::function<void(size_t)>& f) {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            job     = &f;
+            pending = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+        f(0);
+        std::unique_lock<std::mutex> lk(m);
+        done.wait(lk, [&] { return pending == 0; });
+    }
+
+    /** @brief Делит [0, n) на size() кусков и вызывает f(begin, end) для каждого. */
+    template<typename F>
+    void parallelFor(size_t n, F&& f) {
+        const size_t parts = size();
+        run([&](size_t t) {
+            size_t b = n * t / parts, e = n * (t + 1) / parts;
+            if (b < e) f(b, e);
+        });
+    }
+};
+
+/**
+ * @brief Привязывает вызывающий поток к ядру core.
+ *
+ * @return false, если привязка не поддерживается или не удалась (поток
+ *         продолжает работать без неё).
+ */
+static bool pinThisThread(size_t core) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % CPU_SETSIZE, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+/** @brief Запрашивает в кеш все строки (по 64 байта), занятые объектом *p. */
+template<typename T>
+inline void prefetchObject(const T* p) {
+    const char* c = reinterpret_cast<const char*>(p);
+    for (size_t off = 0; off < sizeof(T); off += 64) __builtin_prefetch(c + off);
+}
+
+/** @brief Число одновременно идущих запросов в пакетных lookupBatch() по умолчанию. */
+constexpr size_t kLookupGroup    = 8;
+/** @brief Наибольшее число одновременно идущих запросов пакетного поиска. */
+constexpr size_t kMaxLookupGroup = 64;
+
+/**
+ * @brief Чередует n независимых поисков группами по group одновременно (AMAC).
+ *
+ * Каждый поиск — конечный автомат в своей ячейке Lane. start(lane, i)
+ * начинает запрос i и запрашивает в кеш его первый узел; false —
+ * ответ уже готов и шагов не нужно. step(lane) делает один шаг по загруженному
+ * узлу, запрашивает следующий и возвращает true, когда запрос завершён.
+ * Шаги идут по кругу между ячейками: пока остальные запросы делают свой шаг,
+ * промах по памяти успевает завершиться, и одна цепочка зависимых промахов
+ * превращается в group одновременных. Освободившаяся ячейка сразу
+ * получает следующий запрос.
+ */
+template<typename Lane, typename Start, typename Step>
+static void interleaveLookups(size_t n, size_t group, Start&& start, Step&& step) {
+    Lane lanes[kMaxLookupGroup];
+    group = std::clamp<size_t>(group, 1, kMaxLookupGroup);
+    size_t next = 0, active = 0;
+    auto refill = [&](Lane& lane) {
+        while (next < n)
+            if (start(lane, next++)) return true;
+        return false;
+    };
+    while (active < group && refill(lanes[active])) ++active;
+    while (active) {
+        for (size_t j = 0; j < active;) {
+            if (step(lanes[j]) && !refill(lanes[j])) {
+                lanes[j] = lanes[--active];
+                continue;
+            }
+            ++j;
+        }
+    }
+}
+
 /**
  * @brief Выполняет линейный поиск всех вхождений ключа в массив пассажиров.
  * 
@@ -48,327 +267,5039 @@ std::vector<size_t> linearSearch(const std::vector<Passenger>& arr,
 }
 
 /**
- * @struct BSTNode
- * @brief Узел бинарного дерева поиска.
- * 
- * Хранит ключ, список указателей на пассажиров с этим ключом,
- * а также указатели на левое и правое поддерево.
+ * @class NodeArena
+ * @brief Арена для узлов индексов: выделение сдвигом указателя, освобождение целиком.
+ *
+ * Узлы и их внутренние буферы (строка ключа, список пассажиров) берут память
+ * из одного monotonic_buffer_resource. Поэтому деструкторы узлов не вызываются
+ * вовсе: при разрушении арены вся память возвращается одним release().
  */
-struct BSTNode {
-    std::string               key;        /**< Ключ узла (fullName) */
-    std::vector<const Passenger*> payload; /**< Все пассажиры с этим ключом */
-    BSTNode*  left  = nullptr;             /**< Левое поддерево */
-    BSTNode*  right = nullptr;             /**< Правое поддерево */
-    ~BSTNode()      { delete left; delete right; }/**< Деструктор, освобождающий поддеревья */
-};
+class NodeArena {
+    // Считает байты, реально полученные ареной у системы
+    class CountingResource : public std::pmr::memory_resource {
+        size_t bytes = 0;
+        void* do_allocate(size_t n, size_t align) override {
+            bytes += n;
+            return std::pmr::new_delete_resource()->allocate(n, align);
+        }
+        void do_deallocate(void* p, size_t n, size_t align) override {
+            bytes -= n;
+            std::pmr::new_delete_resource()->deallocate(p, n, align);
+        }
+        bool do_is_equal(const memory_resource& o) const noexcept override { return this == &o; }
+    public:
+        size_t allocated() const { return bytes; }
+    };
 
-/**
- * @class BST
- * @brief Несбалансированное бинарное дерево поиска для хранения Passenger.
- */
-class BST {
-    BSTNode* root = nullptr;
+    CountingResource                    upstream;
+    std::pmr::monotonic_buffer_resource res;
 public:
-    ~BST() { delete root; }
+    explicit NodeArena(size_t initialBytes = 64 * 1024) : res(initialBytes, &upstream) {}
 
-    void insert(const Passenger& p) {
-        if (!root) {
-            root = new BSTNode{p.fullName};
-            root->payload.push_back(&p);
-            return;
-        }
-        BSTNode* cur = root;
-        while (true) {
-            if (p.fullName == cur->key) {
-                cur->payload.push_back(&p);
-                return;
-            } else if (p.fullName < cur->key) {
-                if (!cur->left) cur->left = new BSTNode{p.fullName};
-                cur = cur->left;
-            } else {
-                if (!cur->right) cur->right = new BSTNode{p.fullName};
-                cur = cur->right;
-            }
-        }
+    /** @brief Создаёт объект T в арене; его деструктор вызываться не будет. */
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        return new (res.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
     }
 
-    std::vector<const Passenger*> search(const std::string& key) const {
-        BSTNode* cur = root;
-        while (cur) {
-            if (key == cur->key) return cur->payload;
-            cur = key < cur->key ? cur->left : cur->right;
-        }
-        return {};
-    }
+    std::pmr::memory_resource* resource() { return &res; }
+
+    /** @brief Байт, полученных ареной у системы, включая брошенные при росте буферы. */
+    size_t reservedBytes() const { return upstream.allocated(); }
 };
 
+/**
+ * @struct MemoryUsage
+ * @brief Память, занимаемая индексом, по категориям, байт.
+ *
+ * Поля nodes..buckets — логический объём живых данных. Структуры на арене
+ * дополнительно сообщают arena: сколько арена реально взяла у системы;
+ * разница — буферы списков пассажиров, брошенные при их росте, и запас блоков.
+ */
+struct MemoryUsage {
+    size_t nodes   = 0;     /**< Сами узлы / записи */
+    size_t payload = 0;     /**< Ёмкость списков пассажиров */
+    size_t keys    = 0;     /**< Строки ключей в куче (сверх SSO) */
+    size_t buckets = 0;     /**< Массив корзин / слотов / служебные массивы */
+    size_t arena   = 0;     /**< Получено аренами у системы (0 — арены нет) */
+
+    size_t total() const { return nodes + payload + keys + buckets; }
+};
 
 /**
- * @enum Color
- * @brief Цвет узла красно-чёрного дерева.
+ * @brief Байты, которые строка занимает в куче сверх собственного объекта.
+ *
+ * Короткие строки (SSO) живут внутри объекта и кучу не используют.
  */
-enum Color { RED, BLACK };
+template<typename S>
+size_t stringHeapBytes(const S& s) {
+    static const size_t sso = S().capacity();
+    return s.capacity() > sso ? s.capacity() + 1 : 0;
+}
 
 /**
- * @struct RBTNode
- * @brief Узел красно-чёрного дерева.
- * 
- * Содержит ключ, список указателей на объекты,
- * цвет узла и связи на родителя и потомков.
+ * @enum CabinType
+ * @brief Тип каюты: одно из четырёх обозначений Passenger::cabinType в одном байте.
  */
-struct RBTNode {
-    std::string               key;
-    std::vector<const Passenger*> payload;
-    Color    color   = RED;
-    RBTNode* parent  = nullptr;
-    RBTNode* left    = nullptr;
-    RBTNode* right   = nullptr;
-};
+enum class CabinType : uint8_t { Lux, First, Second, Third };
+
+/** @throws std::invalid_argument Если обозначение не из "Lux", "1", "2", "3". */
+inline CabinType parseCabinType(std::string_view s) {
+    if (s == "Lux") return CabinType::Lux;
+    if (s == "1")   return CabinType::First;
+    if (s == "2")   return CabinType::Second;
+    if (s == "3")   return CabinType::Third;
+    throw std::invalid_argument("неизвестный тип каюты: " + std::string(s));
+}
+
+inline std::string_view cabinTypeName(CabinType t) {
+    static const std::string_view names[] {"Lux", "1", "2", "3"};
+    return names[static_cast<uint8_t>(t)];
+}
 
 /**
- * @class RBTree
- * @brief Самобалансирующееся красно-чёрное дерево для поиска пассажиров.
+ * @class PassengerStore
+ * @brief Пассажиры по столбцам (structure of arrays); строка — номер RowId.
+ *
+ * Имена лежат подряд в одном буфере со смещениями, тип каюты — один байт,
+ * порт — фиксированные kPortLen байт, дополненные нулями. Индексы над
+ * хранилищем держат 32-битные RowId вместо указателей на Passenger.
  */
-class RBTree {
-    RBTNode* root = nullptr;
-    //----------------------------------------
-    //  Повороты
-    void rotateLeft(RBTNode* x) {
-        RBTNode* y = x->right;
-        x->right = y->left;
-        if (y->left) y->left->parent = x;
-        y->parent = x->parent;
-        if (!x->parent) root = y;
-        else if (x == x->parent->left) x->parent->left = y;
-        else                           x->parent->right = y;
-        y->left = x;
-        x->parent = y;
+class PassengerStore {
+public:
+    static constexpr size_t kPortLen = 6;   /**< Наибольшая длина порта назначения */
+private:
+    std::vector<char>      names;           /**< Имена подряд */
+    std::vector<uint32_t>  nameOffsets{0};  /**< Начало имени i, size() + 1 элемент */
+    std::vector<int32_t>   cabinNumbers;
+    std::vector<CabinType> cabinTypes;
+    std::vector<std::array<char, kPortLen>> ports;
+public:
+    PassengerStore() = default;
+
+    /** @throws См. append(). */
+    explicit PassengerStore(const std::vector<Passenger>& data) {
+        size_t chars = 0;
+        for (const auto& p : data) chars += p.fullName.size();
+        names.reserve(chars);
+        nameOffsets.reserve(data.size() + 1);
+        cabinNumbers.reserve(data.size());
+        cabinTypes.reserve(data.size());
+        ports.reserve(data.size());
+        for (const auto& p : data) append(p);
     }
-    void rotateRight(RBTNode* y) {
-        RBTNode* x = y->left;
-        y->left = x->right;
-        if (x->right) x->right->parent = y;
-        x->parent = y->parent;
-        if (!y->parent) root = x;
-        else if (y == y->parent->left) y->parent->left = x;
-        else                           y->parent->right = x;
-        x->right = y;
-        y->parent = x;
+
+    /**
+     * @brief Добавляет строку.
+     *
+     * @return RowId Номер новой строки.
+     * @throws std::length_error      Если порт длиннее kPortLen или строк/байт имён больше 2^32.
+     * @throws std::invalid_argument  Если тип каюты неизвестен.
+     */
+    RowId append(const Passenger& p) {
+        if (p.destinationPort.size() > kPortLen)
+            throw std::length_error("порт длиннее " + std::to_string(kPortLen) + " байт");
+        return append(p.fullName, p.cabinNumber, parseCabinType(p.cabinType), p.destinationPort);
     }
-    //----------------------------------------
-    //  Балансировка после вставки
-    void fixInsert(RBTNode* z) {
-        while (z->parent && z->parent->color == RED) {
-            if (z->parent == z->parent->parent->left) {
-                RBTNode* y = z->parent->parent->right; // дядя
-                if (y && y->color == RED) {
-                    z->parent->color = BLACK;
-                    y->color = BLACK;
-                    z->parent->parent->color = RED;
-                    z = z->parent->parent;
-                } else {
-                    if (z == z->parent->right) {
-                        z = z->parent;
-                        rotateLeft(z);
-                    }
-                    z->parent->color = BLACK;
-                    z->parent->parent->color = RED;
-                    rotateRight(z->parent->parent);
-                }
-            } else {
-                RBTNode* y = z->parent->parent->left;
-                if (y && y->color == RED) {
-                    z->parent->color = BLACK;
-                    y->color = BLACK;
-                    z->parent->parent->color = RED;
-                    z = z->parent->parent;
-                } else {
-                    if (z == z->parent->left) {
-                        z = z->parent;
-                        rotateRight(z);
-                    }
-                    z->parent->color = BLACK;
-                    z->parent->parent->color = RED;
-                    rotateLeft(z->parent->parent);
-                }
-            }
-        }
-        root->color = BLACK;
+
+    /** @brief То же по уже разобранным полям, без Passenger и временных строк. */
+    RowId append(std::string_view fullName, int cabinNumber, CabinType type,
+                 std::string_view destinationPort) {
+        if (destinationPort.size() > kPortLen)
+            throw std::length_error("порт длиннее " + std::to_string(kPortLen) + " байт");
+        if (size() >= UINT32_MAX || names.size() + fullName.size() > UINT32_MAX)
+            throw std::length_error("PassengerStore: превышен размер RowId");
+        names.insert(names.end(), fullName.begin(), fullName.end());
+        nameOffsets.push_back(static_cast<uint32_t>(names.size()));
+        cabinNumbers.push_back(cabinNumber);
+        cabinTypes.push_back(type);
+        std::array<char, kPortLen> port{};
+        std::memcpy(port.data(), destinationPort.data(), destinationPort.size());
+        ports.push_back(port);
+        return static_cast<RowId>(cabinTypes.size() - 1);
     }
-public:
-    ~RBTree() { destroy(root); }
-    void destroy(RBTNode* n) {
-        if (!n) return;
-        destroy(n->left);
-        destroy(n->right);
-        delete n;
+
+    size_t size() const { return cabinTypes.size(); }
+
+    std::string_view name(RowId r) const {
+        return {names.data() + nameOffsets[r], nameOffsets[r + 1] - nameOffsets[r]};
+    }
+    int       cabinNumber(RowId r) const { return cabinNumbers[r]; }
+    CabinType cabinType(RowId r) const   { return cabinTypes[r]; }
+    std::string_view destinationPort(RowId r) const {
+        const char* p = ports[r].data();
+        const void* end = std::memchr(p, '\0', kPortLen);
+        return {p, end ? static_cast<size_t>(static_cast<const char*>(end) - p) : kPortLen};
     }
 
-    void insert(const Passenger& p) {
-        // обычная BST вставка
-        RBTNode* y = nullptr;
-        RBTNode* x = root;
-        while (x) {
-            y = x;
-            if (p.fullName == x->key) {
-                x->payload.push_back(&p);
-                return; // ключ уже есть
-            }
-            x = (p.fullName < x->key) ? x->left : x->right;
-        }
-        RBTNode* z = new RBTNode;
-        z->key = p.fullName;
-        z->payload.push_back(&p);
-        z->parent = y;
-        if (!y)               root = z;
-        else if (p.fullName < y->key) y->left  = z;
-        else                           y->right = z;
-        z->color = RED;
-        fixInsert(z);
+    /** @brief Собирает строку обратно в Passenger. */
+    Passenger row(RowId r) const {
+        return {std::string(name(r)), cabinNumber(r), std::string(cabinTypeName(cabinType(r))),
+                std::string(destinationPort(r))};
     }
 
-    std::vector<const Passenger*> search(const std::string& key) const {
-        RBTNode* cur = root;
-        while (cur) {
-            if (key == cur->key) return cur->payload;
-            cur = (key < cur->key) ? cur->left : cur->right;
-        }
-        return {};
+    /** @brief Память столбцов: keys — имена со смещениями, nodes — остальные столбцы. */
+    MemoryUsage memoryUsage() const {
+        MemoryUsage m;
+        m.keys  = names.capacity() + nameOffsets.capacity() * sizeof(uint32_t);
+        m.nodes = cabinNumbers.capacity() * sizeof(int32_t)
+                + cabinTypes.capacity() * sizeof(CabinType)
+                + ports.capacity() * kPortLen;
+        return m;
     }
 };
 
 /**
- * @class HashTable
- * @brief Хеш-таблица с цепочками для хранения пассажиров по ключу.
+ * @class CsvReader
+ * @brief Потоковое чтение манифеста пассажиров из CSV/TSV кусками фиксированного размера.
+ *
+ * Файл читается блоками по chunkBytes; поля записи возвращаются как
+ * string_view внутрь буфера пакета, без временных строк на поле. Поля
+ * в двойных кавычках могут содержать разделитель, перевод строки и
+ * удвоенную кавычку — последняя сворачивается на месте. Запись,
+ * не поместившаяся в блок, переносится в начало следующего. Первая
+ * запись считается заголовком, если в ней есть поле fullName; тогда
+ * столбцы сопоставляются по именам полей Passenger, иначе ожидается
+ * порядок fullName, cabinNumber, cabinType, destinationPort.
  */
-class HashTable {
-    struct Bucket {
-        std::string            key;
-        std::vector<const Passenger*> payload;
-        Bucket* next = nullptr;
+class CsvReader {
+public:
+    /** @brief Разобранная запись; строки указывают в буфер пакета. */
+    struct Row {
+        std::string_view fullName;
+        int              cabinNumber;
+        CabinType        cabinType;
+        std::string_view destinationPort;
+    };
+    /** @brief Блок файла и разобранные из него записи. */
+    struct Batch {
+        std::vector<char> buf;
+        std::vector<Row>  rows;
+    };
+private:
+    static constexpr size_t kFields = 4;
+    struct Field {
+        char*  begin;
+        size_t len;
+        bool   escaped;         /**< Есть удвоенные кавычки, нужно свернуть */
     };
 
-    std::vector<Bucket*> table;
-    size_t               collisions = 0;
+    std::ifstream     in;
+    std::string       path;
+    size_t            chunk;
+    char              delim;
+    std::vector<char> carry;                    // незавершённая запись прошлого блока
+    std::array<size_t, kFields> column{0, 1, 2, 3};   // номер столбца для каждого поля Row
+    size_t            records  = 0;
+    size_t            consumed = 0;
+    bool              eof      = false;
+    bool              started  = false;
 
-    static size_t hashStr(const std::string& s, size_t mod) {
-        // Полиномиальный rolling-hash
-        const size_t P = 31;
-        size_t h = 0;
-        for (char c : s) h = (h * P + static_cast<size_t>(c)) % mod;
-        return h;
+    [[noreturn]] void fail(const std::string& what) const {
+        throw std::runtime_error(path + ": запись " + std::to_string(records + 1) + ": " + what);
     }
-public:
-    explicit HashTable(size_t nBuckets) : table(nBuckets, nullptr) {}
-    ~HashTable() {
-        for (auto* b : table) {
-            while (b) {
-                Bucket* nxt = b->next;
-                delete b;
-                b = nxt;
+
+    /**
+     * @brief Разбирает запись, начинающуюся в p.
+     *
+     * @return Указатель за концом записи или nullptr, если запись
+     *         обрывается на конце буфера и файл ещё не дочитан.
+     */
+    char* parseRecord(char* p, char* end, std::vector<Field>& fields) const {
+        fields.clear();
+        while (true) {
+            Field f{p, 0, false};
+            if (p < end && *p == '"') {
+                char* q = ++p;
+                while (true) {
+                    q = static_cast<char*>(std::memchr(q, '"', end - q));
+                    if (!q) {
+                        if (!eof) return nullptr;
+                        fail("незакрытая кавычка");
+                    }
+                    if (q + 1 == end && !eof) return nullptr;
+                    if (q + 1 < end && q[1] == '"') { f.escaped = true; q += 2; continue; }
+                    break;
+                }
+                f = {p, static_cast<size_t>(q - p), f.escaped};
+                p = q + 1;
+                if (p < end && *p != delim && *p != '\n' && *p != '\r')
+                    fail("символ после закрывающей кавычки");
+            } else {
+                while (p < end && *p != delim && *p != '\n' && *p != '\r') ++p;
+                f.len = static_cast<size_t>(p - f.begin);
+            }
+            fields.push_back(f);
+            if (p == end) return eof ? p : nullptr;
+            if (*p == delim) { ++p; continue; }
+            if (*p == '\r') {
+                if (p + 1 == end && !eof) return nullptr;
+                if (p + 1 < end && p[1] == '\n') ++p;
             }
+            return p + 1;
         }
     }
 
-    void insert(const Passenger& p) {
-        size_t idx = hashStr(p.fullName, table.size());
-        Bucket* cur = table[idx];
-        if (!cur) {
-            table[idx] = new Bucket{p.fullName};
-            table[idx]->payload.push_back(&p);
-            return;
-        }
-        // цепочка существует => коллизия
-        collisions++;
-        Bucket* prev = nullptr;
-        while (cur) {
-            if (cur->key == p.fullName) {
-                cur->payload.push_back(&p);
-                return;
+    static std::string_view text(Field& f) {
+        if (f.escaped) {
+            char* w = f.begin;
+            for (char *r = f.begin, *e = f.begin + f.len; r < e; ++r) {
+                *w++ = *r;
+                if (*r == '"') ++r;     // вторая кавычка пары
             }
-            prev = cur;
-            cur = cur->next;
+            f.len = static_cast<size_t>(w - f.begin);
+            f.escaped = false;
         }
-        prev->next = new Bucket{p.fullName};
-        prev->next->payload.push_back(&p);
+        return {f.begin, f.len};
     }
 
-    std::vector<const Passenger*> search(const std::string& key) const {
-        size_t idx = hashStr(key, table.size());
-        Bucket* cur = table[idx];
-        while (cur) {
-            if (cur->key == key) return cur->payload;
-            cur = cur->next;
+    // Первая запись: определяет порядок столбцов и сообщает, был ли это заголовок
+    bool readHeader(std::vector<Field>& fields) {
+        static const std::string_view names[kFields] {
+            "fullName", "cabinNumber", "cabinType", "destinationPort"
+        };
+        std::array<size_t, kFields> found;
+        found.fill(SIZE_MAX);
+        for (size_t c = 0; c < fields.size(); ++c)
+            for (size_t k = 0; k < kFields; ++k)
+                if (text(fields[c]) == names[k]) found[k] = c;
+        if (found[0] == SIZE_MAX) return false;
+        for (size_t k = 0; k < kFields; ++k)
+            if (found[k] == SIZE_MAX) fail("в заголовке нет столбца " + std::string(names[k]));
+        column = found;
+        return true;
+    }
+
+    Row toRow(std::vector<Field>& fields) const {
+        for (size_t c : column)
+            if (c >= fields.size()) fail("полей меньше, чем столбцов");
+        Row r;
+        r.fullName = text(fields[column[0]]);
+        std::string_view num = text(fields[column[1]]);
+        auto [ptr, ec] = std::from_chars(num.data(), num.data() + num.size(), r.cabinNumber);
+        if (ec != std::errc() || ptr != num.data() + num.size())
+            fail("номер каюты не число: " + std::string(num));
+        try {
+            r.cabinType = parseCabinType(text(fields[column[2]]));
+        } catch (const std::invalid_argument& e) {
+            fail(e.what());
         }
-        return {};
+        r.destinationPort = text(fields[column[3]]);
+        return r;
+    }
+public:
+    /**
+     * @param path       Путь к файлу.
+     * @param delimiter  Разделитель полей; 0 — определить по первому блоку
+     *                   (табуляция, если она встречается раньше запятой).
+     * @param chunkBytes Размер блока чтения.
+     * @throws std::runtime_error Если файл не открывается.
+     */
+    explicit CsvReader(const std::string& path, char delimiter = 0, size_t chunkBytes = 1 << 20)
+        : in(path, std::ios::binary), path(path), chunk(std::max<size_t>(chunkBytes, 64)),
+          delim(delimiter)
+    {
+        if (!in) throw std::runtime_error("не удалось открыть " + path);
     }
 
-    size_t collisionCount() const { return collisions; }
+    /** @brief Прочитано байт файла. */
+    size_t bytesRead() const { return consumed; }
+    /** @brief Разобрано записей данных (без заголовка). */
+    size_t rowsRead() const { return records; }
+
+    /**
+     * @brief Читает следующий блок и разбирает все завершённые в нём записи.
+     *
+     * Строки прошлого содержимого batch становятся недействительными.
+     * Пустые строки пропускаются.
+     *
+     * @return false, если файл дочитан и записей больше нет.
+     * @throws std::runtime_error При ошибке формата; в сообщении номер записи.
+     */
+    bool read(Batch& batch) {
+        batch.rows.clear();
+        std::vector<Field> fields;
+        while (!eof) {
+            const size_t have = carry.size();
+            if (batch.buf.size() < have + chunk) batch.buf.resize(have + chunk);
+            if (have) std::memcpy(batch.buf.data(), carry.data(), have);
+            in.read(batch.buf.data() + have, static_cast<std::streamsize>(chunk));
+            const size_t got = static_cast<size_t>(in.gcount());
+            consumed += got;
+            eof = got < chunk;
+            char* p   = batch.buf.data();
+            char* end = p + have + got;
+            if (!delim) {
+                char* nl = static_cast<char*>(std::memchr(p, '\n', end - p));
+                char* tab = static_cast<char*>(std::memchr(p, '\t', (nl ? nl : end) - p));
+                char* comma = static_cast<char*>(std::memchr(p, ',', (nl ? nl : end) - p));
+                delim = tab && (!comma || tab < comma) ? '\t' : ',';
+            }
+            while (p < end) {
+                if (*p == '\n' || *p == '\r') { ++p; continue; }
+                char* next = parseRecord(p, end, fields);
+                if (!next) break;
+                p = next;
+                if (!started) {
+                    started = true;
+                    if (readHeader(fields)) continue;
+                }
+                batch.rows.push_back(toRow(fields));
+                ++records;
+            }
+            carry.assign(p, end);
+            if (!batch.rows.empty()) return true;
+            if (carry.size() >= chunk) chunk *= 2;  // запись длиннее блока
+        }
+        return false;
+    }
 };
 
 /**
- * @brief Генерирует случайную строку из строчных букв латинского алфавита.
- * 
- * @param rng Генератор случайных чисел.
- * @param len Длина строки.
- * @return std::string Сгенерированная строка.
+ * @brief Записывает пассажиров в CSV с заголовком; поля с разделителем, кавычкой
+ *        или переводом строки берутся в кавычки.
+ *
+ * @throws std::runtime_error При ошибке записи.
  */
-std::string randomString(std::mt19937& rng, size_t len) {
-    std::uniform_int_distribution<int> dist('a', 'z');
-    std::string s(len, '\0');
-    for (char& c : s) c = static_cast<char>(dist(rng));
-    return s;
+static void writePassengersCsv(const std::string& path, const std::vector<Passenger>& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) throw std::runtime_error("не удалось создать " + path);
+    auto field = [&](const std::string& s) {
+        if (s.find_first_of(",\"\r\n") == std::string::npos) {
+            out << s;
+            return;
+        }
+        out << '"';
+        for (char c : s) out << (c == '"' ? "\"\"" : std::string_view(&c, 1));
+        out << '"';
+    };
+    out << "fullName,cabinNumber,cabinType,destinationPort\n";
+    for (const auto& p : data) {
+        field(p.fullName);
+        out << ',' << p.cabinNumber << ',';
+        field(p.cabinType);
+        out << ',';
+        field(p.destinationPort);
+        out << '\n';
+    }
+    out.close();
+    if (!out) throw std::runtime_error("ошибка записи " + path);
 }
 
 /**
- * @brief Создаёт вектор пассажиров с гарантированными дубликатами ключей.
- * 
- * @param n Количество пассажиров.
- * @param rng Генератор случайных чисел.
- * @return std::vector<Passenger> Вектор пассажиров.
+ * @brief Загружает CSV в store, разбирая следующий блок, пока предыдущий
+ *        добавляется в хранилище и индексы.
+ *
+ * Чтение и разбор идут на отдельном потоке, добавление и onRows — на
+ * вызывающем; между ними очередь из depth пакетов, так что память
+ * ограничена depth блоками независимо от размера файла.
+ *
+ * @param onRows Вызывается как onRows(first, last) для каждого пакета
+ *               добавленных строк [first, last) — здесь строятся индексы.
+ * @return size_t Число загруженных строк.
+ * @throws Исключения CsvReader, PassengerStore::append и onRows.
  */
-std::vector<Passenger> makeData(size_t n, std::mt19937& rng) {
-    // 6.1 Ограниченный пул имён (~5 % от n)
-    size_t uniqueCnt = std::max<size_t>(10, n / 20);
-    std::vector<std::string> pool;
-    pool.reserve(uniqueCnt);
-    for (size_t i = 0; i < uniqueCnt; ++i) pool.push_back(randomString(rng, 10));
+template<typename OnRows>
+static size_t ingestCsv(CsvReader& reader, PassengerStore& store, OnRows&& onRows,
+                        size_t depth = 3)
+{
+    std::vector<CsvReader::Batch> batches(std::max<size_t>(depth, 1));
+    std::deque<CsvReader::Batch*> freeQ, fullQ;
+    for (auto& b : batches) freeQ.push_back(&b);
+    std::mutex              m;
+    std::condition_variable cv;
+    bool                    finished = false, aborted = false;
+    std::exception_ptr      error;
+    const size_t            start = store.size();
 
-    std::uniform_int_distribution<int> cabinNum(1, 1000);
-    static const std::string types[] {"Lux", "1", "2", "3"};
-    std::uniform_int_distribution<int> typeDist(0, 3);
+    ThreadPool pool(2);
+    pool.run([&](size_t id) {
+        try {
+            if (id == 1) {
+                while (true) {
+                    CsvReader::Batch* b;
+                    {
+                        std::unique_lock<std::mutex> lk(m);
+                        cv.wait(lk, [&] { return aborted || !freeQ.empty(); });
+                        if (aborted) return;
+                        b = freeQ.front();
+                        freeQ.pop_front();
+                    }
+                    bool more = reader.read(*b);
+                    {
+                        std::lock_guard<std::mutex> lk(m);
+                        if (more) fullQ.push_back(b); else finished = true;
+                    }
+                    cv.notify_all();
+                    if (!more) return;
+                }
+            }
+            while (true) {
+                CsvReader::Batch* b;
+                {
+                    std::unique_lock<std::mutex> lk(m);
+                    cv.wait(lk, [&] { return aborted || finished || !fullQ.empty(); });
+                    if (aborted || fullQ.empty()) return;
+                    b = fullQ.front();
+                    fullQ.pop_front();
+                }
+                const RowId first = static_cast<RowId>(store.size());
+                for (const auto& r : b->rows)
+                    store.append(r.fullName, r.cabinNumber, r.cabinType, r.destinationPort);
+                onRows(first, static_cast<RowId>(store.size()));
+                {
+                    std::lock_guard<std::mutex> lk(m);
+                    freeQ.push_back(b);
+                }
+                cv.notify_all();
+            }
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lk(m);
+                if (!error) error = std::current_exception();
+                aborted = true;
+            }
+            cv.notify_all();
+        }
+    });
+    if (error) std::rethrow_exception(error);
+    return store.size() - start;
+}
 
-    std::vector<Passenger> v;
-    v.reserve(n);
-    for (size_t i = 0; i < n; ++i) {
-        Passenger p;
-        p.fullName = pool[rng() % pool.size()];          // дубликаты гарантированы
-        p.cabinNumber = cabinNum(rng);
-        p.cabinType = types[typeDist(rng)];
-        p.destinationPort = randomString(rng, 6);
-        v.push_back(std::move(p));
-    }
+/**
+ * @brief Читает 8 байт как беззнаковое число в порядке big-endian.
+ *
+ * Так сравнение чисел совпадает с побайтовым (memcmp) сравнением строк.
+ */
+inline uint64_t loadBE64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
     return v;
 }
 
 /**
- * @struct ResultRow
- * @brief Структура для хранения результатов измерений времени и коллизий.
+ * @struct KeyPrefix
+ * @brief Первые 16 байт ключа как два 64-битных слова в порядке big-endian.
+ *
+ * Сравнение пар слов совпадает с лексикографическим порядком строк
+ * (недостающие байты — нули), поэтому префиксы сортируются и сравниваются
+ * парой целочисленных сравнений без обращения к строке.
  */
-struct ResultRow {
-    size_t size;            /**< Размер данных */
-    double tLinear;         /**< Время линейного поиска, нс */
-    double tBST;            /**< Время поиска в BST, нс */
-    double tRBT;            /**< Время поиска в красно-чёрном дереве, нс */
-    double tHash;           /**< Время поиска в хеш-таблице, нс */
-    double tMultimap;       /**< Время поиска в std::multimap, нс */
-    size_t collisions;      /**< Количество коллизий хеш-таблицы */
+struct KeyPrefix {
+    uint64_t hi = 0;    /**< Байты 0..7 */
+    uint64_t lo = 0;    /**< Байты 8..15 */
+
+    static KeyPrefix of(std::string_view key) {
+        unsigned char buf[16] = {};
+        std::memcpy(buf, key.data(), std::min<size_t>(key.size(), 16));
+        return {loadBE64(buf), loadBE64(buf + 8)};
+    }
+    bool operator==(const KeyPrefix& o) const { return hi == o.hi && lo == o.lo; }
+    bool operator!=(const KeyPrefix& o) const { return !(*this == o); }
+    bool operator<(const KeyPrefix& o) const  { return hi != o.hi ? hi < o.hi : lo < o.lo; }
 };
 
 /**
- * @brief Функция для измерения времени выполнения переданной функции.
- * 
- * @tparam F Тип callable объекта (лямбда, функция и т.п.).
+ * @struct FixedKey
+ * @brief Ключ фиксированной ширины: до 15 байт строки и её длина в 16 байтах.
+ *
+ * Байты строки, дополненные нулями, занимают позиции 0..14, длина — позицию 15;
+ * всё читается как два big-endian слова. Такой порядок совпадает
+ * со строковым (более короткий префикс меньше), поэтому равенство
+ * и сравнение — два целочисленных сравнения без обращения к куче.
+ */
+struct FixedKey {
+    static constexpr size_t kMaxLen = 15;   /**< Наибольшая длина ключа */
+
+    uint64_t hi = 0;    /**< Байты 0..7 */
+    uint64_t lo = 0;    /**< Байты 8..14 и длина */
+
+    FixedKey() = default;
+    /** @pre fits(s) */
+    explicit FixedKey(std::string_view s) {
+        unsigned char buf[16] = {};
+        std::memcpy(buf, s.data(), s.size());
+        buf[15] = static_cast<unsigned char>(s.size());
+        hi = loadBE64(buf);
+        lo = loadBE64(buf + 8);
+    }
+
+    static bool fits(std::string_view s) { return s.size() <= kMaxLen; }
+
+    size_t size() const { return static_cast<size_t>(lo & 0xff); }
+    /** @brief Раскладывает ключ в buf[16]; строка — первые size() байт. */
+    std::string_view view(char* buf) const {
+        for (int i = 0; i < 8; ++i) buf[i]     = static_cast<char>(hi >> (56 - 8 * i));
+        for (int i = 0; i < 8; ++i) buf[8 + i] = static_cast<char>(lo >> (56 - 8 * i));
+        return {buf, size()};
+    }
+    std::string str() const {
+        char buf[16];
+        return std::string(view(buf));
+    }
+
+    bool operator==(const FixedKey& o) const { return hi == o.hi && lo == o.lo; }
+    bool operator!=(const FixedKey& o) const { return !(*this == o); }
+    bool operator<(const FixedKey& o) const  { return hi != o.hi ? hi < o.hi : lo < o.lo; }
+};
+
+/** @brief Для ключа FixedKey куча не используется. */
+inline size_t stringHeapBytes(const FixedKey&) { return 0; }
+
+/**
+ * @class NameColumn
+ * @brief Столбец имён для полного просмотра: по 16 байт на запись подряд.
+ *
+ * Ячейка i — FixedKey имени arr[i]. Имена длиннее FixedKey::kMaxLen хранятся
+ * первыми 15 байтами с длиной 0xFF: такая ячейка совпадает с запросом
+ * по тем же 15 байтам, и совпадение проверяется полным сравнением строки.
+ * Сравнение ячейки — одно 16-байтовое сравнение; на x86 при поддержке
+ * процессором используется AVX2 (две ячейки за инструкцию), иначе SSE2,
+ * на AArch64 — NEON, в остальных случаях — два 64-битных сравнения.
+ * Столбец — снимок имён на момент построения, строится из вектора
+ * Passenger или из PassengerStore.
+ */
+class NameColumn {
+    struct AlignedFree {
+        void operator()(FixedKey* p) const { ::operator delete[](p, std::align_val_t{64}); }
+    };
+    using Kernel = void (*)(const FixedKey*, size_t, size_t, FixedKey, std::vector<size_t>&);
+
+    static constexpr uint64_t kLongMark = 0xff;   /**< Длина в ячейке длинного имени */
+    static constexpr size_t   kParallelMin = 1 << 16;  /**< Меньшие столбцы — в одном потоке */
+
+    std::unique_ptr<FixedKey[], AlignedFree> cells;
+    size_t                              n = 0;
+    std::vector<std::pair<size_t, std::string>> longNames;  /**< Длинные имена по возрастанию i */
+    Kernel                              kernel = pickKernel();
+
+    static FixedKey cellOf(std::string_view s) {
+        if (FixedKey::fits(s)) return FixedKey(s);
+        FixedKey k(s.substr(0, FixedKey::kMaxLen));
+        k.lo |= kLongMark;
+        return k;
+    }
+
+    // Ядра: индексы i из [b, e), где cells[i] == q, дописываются в out по возрастанию
+    static void scanScalar(const FixedKey* c, size_t b, size_t e, FixedKey q,
+                           std::vector<size_t>& out) {
+        for (size_t i = b; i < e; ++i)
+            if (c[i] == q) out.push_back(i);
+    }
+#if defined(__SSE2__)
+    static void scanSse2(const FixedKey* c, size_t b, size_t e, FixedKey q,
+                         std::vector<size_t>& out) {
+        const __m128i qv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&q));
+        auto eq = [&](size_t i) {
+            __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(c + i));
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(v, qv)) == 0xffff;
+        };
+        size_t i = b;
+        for (; i + 4 <= e; i += 4) {        // одна кеш-линия за шаг
+            bool e0 = eq(i), e1 = eq(i + 1), e2 = eq(i + 2), e3 = eq(i + 3);
+            if (e0 | e1 | e2 | e3) {
+                if (e0) out.push_back(i);
+                if (e1) out.push_back(i + 1);
+                if (e2) out.push_back(i + 2);
+                if (e3) out.push_back(i + 3);
+            }
+        }
+        for (; i < e; ++i)
+            if (eq(i)) out.push_back(i);
+    }
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    __attribute__((target("avx2")))
+    static void scanAvx2(const FixedKey* c, size_t b, size_t e, FixedKey q,
+                         std::vector<size_t>& out) {
+        const __m256i qv = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(&q)));
+        size_t i = b;
+        for (; i < e && (i & 1); ++i)
+            if (c[i] == q) out.push_back(i);
+        for (; i + 4 <= e; i += 4) {
+            __m256i v0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(c + i));
+            __m256i v1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(c + i + 2));
+            uint32_t m0 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v0, qv)));
+            uint32_t m1 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, qv)));
+            // каждая половина маски — одна ячейка
+            if ((m0 & 0xffff) == 0xffff) out.push_back(i);
+            if ((m0 >> 16) == 0xffff)    out.push_back(i + 1);
+            if ((m1 & 0xffff) == 0xffff) out.push_back(i + 2);
+            if ((m1 >> 16) == 0xffff)    out.push_back(i + 3);
+        }
+        for (; i < e; ++i)
+            if (c[i] == q) out.push_back(i);
+    }
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+    static void scanNeon(const FixedKey* c, size_t b, size_t e, FixedKey q,
+                         std::vector<size_t>& out) {
+        const uint8x16_t qv = vld1q_u8(reinterpret_cast<const uint8_t*>(&q));
+        for (size_t i = b; i < e; ++i) {
+            uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(c + i));
+            if (vminvq_u8(vceqq_u8(v, qv)) == 0xff) out.push_back(i);
+        }
+    }
+#endif
+
+    static Kernel pickKernel() {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        if (__builtin_cpu_supports("avx2")) return scanAvx2;
+#endif
+#if defined(__SSE2__)
+        return scanSse2;
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+        return scanNeon;
+#else
+        return scanScalar;
+#endif
+    }
+
+    // Отбрасывает совпадения по префиксу у длинных имён, не равных key
+    void verify(std::string_view key, std::vector<size_t>& idx) const {
+        if (FixedKey::fits(key)) return;
+        auto fullName = [&](size_t i) -> std::string_view {
+            return std::lower_bound(longNames.begin(), longNames.end(), i,
+                                    [](const auto& e, size_t j) { return e.first < j; })->second;
+        };
+        idx.erase(std::remove_if(idx.begin(), idx.end(),
+                                 [&](size_t i) { return fullName(i) != key; }),
+                  idx.end());
+    }
+
+    // nameOf(i) — имя строки i
+    template<typename NameOf>
+    void fill(size_t rows, NameOf&& nameOf) {
+        n = rows;
+        cells.reset(static_cast<FixedKey*>(
+            ::operator new[](std::max<size_t>(n, 1) * sizeof(FixedKey), std::align_val_t{64})));
+        for (size_t i = 0; i < n; ++i) {
+            std::string_view s = nameOf(i);
+            cells[i] = cellOf(s);
+            if (!FixedKey::fits(s)) longNames.emplace_back(i, std::string(s));
+        }
+    }
+public:
+    explicit NameColumn(const std::vector<Passenger>& arr) {
+        fill(arr.size(), [&](size_t i) -> std::string_view { return arr[i].fullName; });
+    }
+    explicit NameColumn(const PassengerStore& store) {
+        fill(store.size(), [&](size_t i) { return store.name(static_cast<RowId>(i)); });
+    }
+
+    /**
+     * @brief Индексы всех записей с именем key, по возрастанию (как linearSearch).
+     */
+    std::vector<size_t> scan(std::string_view key) const {
+        std::vector<size_t> idx;
+        if (!FixedKey::fits(key) && longNames.empty()) return idx;
+        kernel(cells.get(), 0, n, cellOf(key), idx);
+        verify(key, idx);
+        return idx;
+    }
+
+    /**
+     * @brief То же, что scan(key), но столбец делится между потоками пула.
+     */
+    std::vector<size_t> scan(std::string_view key, ThreadPool& pool) const {
+        const size_t T = pool.size();
+        if (T == 1 || n < kParallelMin) return scan(key);
+        std::vector<size_t> idx;
+        if (!FixedKey::fits(key) && longNames.empty()) return idx;
+        const FixedKey q = cellOf(key);
+        std::vector<std::vector<size_t>> parts(T);
+        pool.run([&](size_t t) {
+            // границы кусков кратны 4 ячейкам (кеш-линии)
+            size_t b = n * t / T & ~size_t(3), e = t + 1 == T ? n : n * (t + 1) / T & ~size_t(3);
+            kernel(cells.get(), b, e, q, parts[t]);
+        });
+        size_t total = 0;
+        for (const auto& p : parts) total += p.size();
+        idx.reserve(total);
+        for (const auto& p : parts) idx.insert(idx.end(), p.begin(), p.end());
+        verify(key, idx);
+        return idx;
+    }
+
+    MemoryUsage memoryUsage() const {
+        MemoryUsage m;
+        m.buckets = n * sizeof(FixedKey);
+        for (const auto& e : longNames) m.keys += sizeof(e) + stringHeapBytes(e.second);
+        return m;
+    }
+};
+
+/**
+ * @struct KeyTraits
+ * @brief Способ хранения ключа в узлах деревьев.
+ *
+ * Stored — тип ключа в узле, Probe — тип ключа запроса. Искомая строка
+ * переводится в Probe один раз, дальше на каждом уровне спуска
+ * сравниваются Probe и Stored. assign() перезаписывает ключ узла,
+ * взятого повторно из списка свободных; view() даёт ключ узла строкой,
+ * используя buf[16], если ключ хранится не строкой.
+ *
+ * @tparam Key std::string (строка в арене) или FixedKey (16 байт внутри узла).
+ */
+template<typename Key> struct KeyTraits;
+
+template<> struct KeyTraits<std::string> {
+    using Stored = std::pmr::string;
+    using Probe  = std::string_view;
+
+    static bool toProbe(std::string_view s, Probe& out) { out = s; return true; }
+    static Stored store(Probe k, std::pmr::memory_resource* r) { return Stored(k, r); }
+    static void assign(Stored& s, Probe k) { s.assign(k.data(), k.size()); }
+    static std::string_view view(const Stored& s, char*) { return s; }
+};
+
+template<> struct KeyTraits<FixedKey> {
+    using Stored = FixedKey;
+    using Probe  = FixedKey;
+
+    static bool toProbe(std::string_view s, Probe& out) {
+        if (!FixedKey::fits(s)) return false;
+        out = FixedKey(s);
+        return true;
+    }
+    static Stored store(Probe k, std::pmr::memory_resource*) { return k; }
+    static void assign(Stored& s, Probe k) { s = k; }
+    static std::string_view view(const Stored& s, char* buf) { return s.view(buf); }
+};
+
+/**
+ * @brief Переводит ключ вставляемой записи в Probe.
+ *
+ * @throws std::length_error Если ключ не представим типом Key.
+ */
+template<typename Key>
+typename KeyTraits<Key>::Probe insertKey(std::string_view s) {
+    typename KeyTraits<Key>::Probe k;
+    if (!KeyTraits<Key>::toProbe(s, k))
+        throw std::length_error("ключ длиннее " + std::to_string(FixedKey::kMaxLen) + " байт");
+    return k;
+}
+
+/**
+ * @struct KeyBound
+ * @brief Условие продолжения упорядоченного обхода.
+ *
+ * Либо ключи не больше key (диапазон с включённой верхней границей),
+ * либо ключи, начинающиеся с key (поиск по префиксу).
+ */
+struct KeyBound {
+    std::string key;        /**< Верхняя граница или префикс */
+    bool        prefix;     /**< true — ключ должен начинаться с key */
+
+    bool admits(std::string_view k) const {
+        return prefix ? k.substr(0, key.size()) == key : k <= key;
+    }
+};
+
+/**
+ * @class KeyRange
+ * @brief Ленивый упорядоченный обход ключей дерева от нижней границы до KeyBound.
+ *
+ * Узлы не собираются заранее: каждый шаг итератора — переход к преемнику
+ * в дереве, обход прекращается на первом ключе вне границы. Разыменование
+ * даёт View на пассажиров одного ключа. Пока обход не закончен, дерево
+ * менять нельзя.
+ *
+ * @tparam Cursor Позиция в дереве: node() — текущий узел или nullptr,
+ *                next() — переход к преемнику.
+ */
+template<typename Cursor>
+class KeyRange {
+    using Node  = typename Cursor::Node;
+    using Key   = typename Cursor::Key;
+public:
+    using Value = typename Cursor::Value;
+
+    class iterator {
+        Cursor        cur;
+        KeyBound      bound;                // копия: итератор переживает свой KeyRange
+        mutable char  buf[16];
+
+        void settle() {
+            if (cur.node() && !bound.admits(key())) cur = Cursor();
+        }
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = View<Value>;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = View<Value>;
+
+        iterator() = default;
+        iterator(Cursor c, KeyBound b) : cur(std::move(c)), bound(std::move(b)) { settle(); }
+
+        /** @brief Ключ текущего узла; для FixedKey живёт до следующего вызова. */
+        std::string_view key() const { return KeyTraits<Key>::view(cur.node()->key, buf); }
+
+        View<Value> operator*() const { return View<Value>(cur.node()->payload); }
+        iterator& operator++() {
+            cur.next();
+            settle();
+            return *this;
+        }
+        bool operator==(const iterator& o) const { return cur.node() == o.cur.node(); }
+        bool operator!=(const iterator& o) const { return !(*this == o); }
+    };
+
+    KeyRange(Cursor first, KeyBound bound) : first(std::move(first)), bound(std::move(bound)) {}
+
+    iterator begin() const { return iterator(first, bound); }
+    iterator end() const   { return iterator(); }
+
+    /** @brief Число пассажиров в диапазоне. */
+    size_t count() const {
+        size_t n = 0;
+        for (View<Value> v : *this) n += v.size();
+        return n;
+    }
+    /** @brief Все пассажиры диапазона в порядке ключей. */
+    std::vector<Value> collect() const {
+        std::vector<Value> out;
+        for (View<Value> v : *this) out.insert(out.end(), v.begin(), v.end());
+        return out;
+    }
+private:
+    Cursor   first;
+    KeyBound bound;
+};
+
+/**
+ * @struct SortItem
+ * @brief Компактный элемент сортировки записей по ключу.
+ */
+struct SortItem {
+    KeyPrefix prefix;   /**< Префикс ключа */
+    size_t    len;      /**< Длина ключа */
+    size_t    idx;      /**< Номер записи во входном векторе */
+};
+
+/**
+ * @brief Сравнивает ключи двух записей в строковом порядке.
+ *
+ * Префикс и длина дают точный порядок для ключей до 16 байт; более длинные
+ * ключи с общим префиксом сравниваются полностью.
+ */
+inline bool keyLess(const SortItem& a, const SortItem& b, const std::vector<Passenger>& data) {
+    if (a.prefix != b.prefix) return a.prefix < b.prefix;
+    if (a.len <= 16 && b.len <= 16) return a.len < b.len;
+    return data[a.idx].fullName < data[b.idx].fullName;
+}
+
+/** @brief Проверяет, что у двух записей одинаковый ключ. */
+inline bool sameKey(const SortItem& a, const SortItem& b, const std::vector<Passenger>& data) {
+    return a.prefix == b.prefix && a.len == b.len
+        && (a.len <= 16 || data[a.idx].fullName == data[b.idx].fullName);
+}
+
+/**
+ * @brief Устойчиво упорядочивает записи по ключу.
+ *
+ * Сортируются не записи, а компактные SortItem: куски — параллельно
+ * в пуле, затем попарное слияние. Записи с равным ключом сохраняют
+ * исходный порядок.
+ *
+ * @param data Данные.
+ * @param pool Пул потоков.
+ * @return std::vector<SortItem> Элементы в порядке ключей.
+ */
+static std::vector<SortItem> sortByKey(const std::vector<Passenger>& data, ThreadPool& pool) {
+    const size_t T = pool.size(), n = data.size();
+    std::vector<SortItem> items(n);
+    pool.parallelFor(n, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
+            items[i] = {KeyPrefix::of(data[i].fullName), data[i].fullName.size(), i};
+    });
+    auto less = [&](const SortItem& a, const SortItem& b) { return keyLess(a, b, data); };
+    auto at   = [&](size_t c) { return items.begin() + n * std::min(c, T) / T; };
+    pool.run([&](size_t c) { std::stable_sort(at(c), at(c + 1), less); });
+    for (size_t w = 1; w < T; w *= 2)
+        for (size_t c = 0; c + w < T; c += 2 * w)
+            std::inplace_merge(at(c), at(c + w), at(c + 2 * w), less);
+    return items;
+}
+
+/**
+ * @brief Удаляет v из списка пассажиров, сохраняя порядок остальных.
+ *
+ * @return true, если v был в списке.
+ */
+template<typename Vec, typename V>
+static bool removePassenger(Vec& payload, const V& v) {
+    auto it = std::find(payload.begin(), payload.end(), v);
+    if (it == payload.end()) return false;
+    payload.erase(it);
+    return true;
+}
+
+/**
+ * @brief Заменяет from на to на том же месте списка пассажиров.
+ *
+ * @return true, если from был в списке.
+ */
+template<typename Vec, typename V>
+static bool replacePassenger(Vec& payload, const V& from, const V& to) {
+    auto it = std::find(payload.begin(), payload.end(), from);
+    if (it == payload.end()) return false;
+    *it = to;
+    return true;
+}
+
+/**
+ * @struct BasicBSTNode
+ * @brief Узел бинарного дерева поиска.
+ * 
+ * Хранит ключ, список пассажиров с этим ключом,
+ * а также указатели на левое и правое поддерево.
+ * Память узла и его буферов принадлежит арене дерева.
+ *
+ * @tparam Key   Представление ключа (см. KeyTraits).
+ * @tparam Value Ссылка на пассажира: указатель или номер строки RowId.
+ */
+template<typename Key, typename Value = const Passenger*>
+struct BasicBSTNode {
+    typename KeyTraits<Key>::Stored    key;     /**< Ключ узла (fullName) */
+    std::pmr::vector<Value>            payload; /**< Все пассажиры с этим ключом */
+    BasicBSTNode* left  = nullptr;              /**< Левое поддерево */
+    BasicBSTNode* right = nullptr;              /**< Правое поддерево */
+
+    BasicBSTNode(typename KeyTraits<Key>::Probe k, std::pmr::memory_resource* r)
+        : key(KeyTraits<Key>::store(k, r)), payload(r) {}
+};
+
+/**
+ * @class BSTCursor
+ * @brief Позиция симметричного обхода BasicBST: у узлов нет ссылок на родителя,
+ *        поэтому путь хранится в стеке.
+ *
+ * На вершине стека текущий узел, под ним — предки, в чьём левом
+ * поддереве он лежит, то есть следующие по порядку.
+ */
+template<typename K, typename V>
+class BSTCursor {
+public:
+    using Key   = K;
+    using Value = V;
+    using Node  = BasicBSTNode<K, V>;
+
+    BSTCursor() = default;
+
+    /** @brief Первый узел с ключом не меньше lo. */
+    BSTCursor(const Node* root, std::string_view lo) {
+        char buf[16];
+        for (const Node* x = root; x;) {
+            if (KeyTraits<Key>::view(x->key, buf) >= lo) {
+                stack.push_back(x);
+                x = x->left;
+            } else {
+                x = x->right;
+            }
+        }
+    }
+
+    const Node* node() const { return stack.empty() ? nullptr : stack.back(); }
+    void next() {
+        const Node* x = stack.back()->right;
+        stack.pop_back();
+        for (; x; x = x->left) stack.push_back(x);
+    }
+private:
+    std::vector<const Node*> stack;
+};
+
+/**
+ * @brief Обходит двоичное дерево без рекурсии и считает занимаемую им память.
+ *
+ * Узлы списка свободных freeNodes (связанного через left) тоже учитываются:
+ * они остаются в арене до её освобождения.
+ */
+template<typename Node>
+MemoryUsage treeMemory(const Node* root, const Node* freeNodes, const NodeArena& arena) {
+    MemoryUsage m;
+    auto account = [&](const Node* x) {
+        m.nodes   += sizeof(Node);
+        m.payload += x->payload.capacity() * sizeof(x->payload[0]);
+        m.keys    += stringHeapBytes(x->key);
+    };
+    std::vector<const Node*> stack;
+    if (root) stack.push_back(root);
+    while (!stack.empty()) {
+        const Node* x = stack.back();
+        stack.pop_back();
+        account(x);
+        if (x->left)  stack.push_back(x->left);
+        if (x->right) stack.push_back(x->right);
+    }
+    for (const Node* x = freeNodes; x; x = x->left) account(x);
+    m.arena = arena.reservedBytes();
+    return m;
+}
+
+/**
+ * @brief Высота двоичного дерева (число узлов на самом длинном пути), без рекурсии.
+ */
+template<typename Node>
+size_t treeHeight(const Node* root) {
+    size_t h = 0;
+    std::vector<std::pair<const Node*, size_t>> stack;
+    if (root) stack.push_back({root, 1});
+    while (!stack.empty()) {
+        auto [x, d] = stack.back();
+        stack.pop_back();
+        h = std::max(h, d);
+        if (x->left)  stack.push_back({x->left, d + 1});
+        if (x->right) stack.push_back({x->right, d + 1});
+    }
+    return h;
+}
+
+/**
+ * @enum BSTBalance
+ * @brief Режим балансировки BasicBST.
+ */
+enum class BSTBalance {
+    None,       /**< Обычное BST: на отсортированном вводе вырождается в список */
+    Scapegoat   /**< Дерево-козёл отпущения: перестройка поддерева при слишком глубокой вставке */
+};
+
+/**
+ * @class BasicBST
+ * @brief Бинарное дерево поиска для хранения Passenger, без балансировки
+ *        или с перестройками scapegoat.
+ *
+ * Удалённые узлы не возвращаются арене, а попадают в список свободных
+ * и переиспользуются следующими вставками вместе со своими буферами.
+ *
+ * В режиме BSTBalance::Scapegoat узлы не меняются: вставка, ушедшая
+ * глубже log_{1/α} n, ищет на пути вверх первого предка, у которого одно
+ * поддерево больше α его размера, и собирает его поддерево заново
+ * идеально сбалансированным; удаление перестраивает всё дерево, когда
+ * узлов становится меньше α от максимума с прошлой перестройки. Высота
+ * остаётся O(log n), вставка — O(log n) амортизированно.
+ *
+ * @tparam Key   Представление ключа: std::string или FixedKey.
+ * @tparam Value Ссылка на пассажира: const Passenger* или RowId. Методы,
+ *               принимающие Passenger, есть только у варианта с указателями.
+ */
+template<typename Key, typename Value = const Passenger*>
+class BasicBST {
+    using Node  = BasicBSTNode<Key, Value>;
+    using Probe = typename KeyTraits<Key>::Probe;
+public:
+    using Cursor = BSTCursor<Key, Value>;
+private:
+
+    static constexpr double kAlpha = 0.7;   /**< Допустимая доля поддерева в scapegoat */
+
+    NodeArena  arena;
+    Node*      root      = nullptr;
+    Node*      freeNodes = nullptr;  /**< Список свободных узлов (через left) */
+    BSTBalance balance;
+    size_t     nodeCount = 0;        /**< Узлов (различных ключей) в дереве */
+    size_t     maxCount  = 0;        /**< Наибольшее nodeCount с последней полной перестройки */
+
+    Node* newNode(const Probe& k) {
+        ++nodeCount;
+        maxCount = std::max(maxCount, nodeCount);
+        if (!freeNodes) return arena.make<Node>(k, arena.resource());
+        Node* x = freeNodes;
+        freeNodes = x->left;
+        KeyTraits<Key>::assign(x->key, k);
+        x->left = nullptr;
+        return x;
+    }
+
+    void release(Node* x) {
+        --nodeCount;
+        x->payload.clear();
+        x->right  = nullptr;
+        x->left   = freeNodes;
+        freeNodes = x;
+    }
+
+    static size_t subtreeSize(const Node* x) {
+        size_t n = 0;
+        std::vector<const Node*> stack;
+        if (x) stack.push_back(x);
+        while (!stack.empty()) {
+            const Node* y = stack.back();
+            stack.pop_back();
+            ++n;
+            if (y->left)  stack.push_back(y->left);
+            if (y->right) stack.push_back(y->right);
+        }
+        return n;
+    }
+
+    // Сборка поддерева из узлов [lo, hi) в порядке ключей; глубина рекурсии ~log n
+    static Node* link(const std::vector<Node*>& nodes, size_t lo, size_t hi) {
+        if (lo >= hi) return nullptr;
+        size_t mid = lo + (hi - lo) / 2;
+        Node*  x   = nodes[mid];
+        x->left  = link(nodes, lo, mid);
+        x->right = link(nodes, mid + 1, hi);
+        return x;
+    }
+
+    // Перестраивает поддерево *at в идеально сбалансированное
+    static void rebuild(Node** at) {
+        std::vector<Node*> nodes, stack;
+        for (Node* x = *at; x || !stack.empty();) {
+            for (; x; x = x->left) stack.push_back(x);
+            x = stack.back();
+            stack.pop_back();
+            nodes.push_back(x);
+            x = x->right;
+        }
+        *at = link(nodes, 0, nodes.size());
+    }
+
+    /**
+     * @brief Ищет на пути вставки козла отпущения и перестраивает его поддерево.
+     *
+     * @param path Ссылки на узлы от корня до родителя нового узла.
+     */
+    void rebalanceAfterInsert(const std::vector<Node**>& path, const Node* inserted) {
+        size_t      childSize = 1;
+        const Node* child     = inserted;
+        for (size_t i = path.size(); i-- > 0;) {
+            Node*  x    = *path[i];
+            size_t size = childSize + 1 + subtreeSize(x->left == child ? x->right : x->left);
+            if (childSize > kAlpha * size) {
+                rebuild(path[i]);
+                return;
+            }
+            childSize = size;
+            child     = x;
+        }
+    }
+
+    size_t depthLimit() const {
+        return static_cast<size_t>(std::log(double(nodeCount)) / std::log(1 / kAlpha));
+    }
+
+    // Ссылка на узел ключа k из родителя (или root); *результат == nullptr, если ключа нет
+    Node** findLink(const Probe& k) {
+        Node** link = &root;
+        while (*link && !(k == (*link)->key))
+            link = k < (*link)->key ? &(*link)->left : &(*link)->right;
+        return link;
+    }
+
+    // Вынимает узел *link из дерева; на его место встаёт преемник
+    void unlink(Node** link) {
+        Node* x = *link;
+        if (!x->left) {
+            *link = x->right;
+        } else if (!x->right) {
+            *link = x->left;
+        } else {
+            Node** s = &x->right;
+            while ((*s)->left) s = &(*s)->left;
+            Node* succ = *s;
+            *s = succ->right;
+            succ->left  = x->left;
+            succ->right = x->right;
+            *link = succ;
+        }
+        release(x);
+        if (balance == BSTBalance::Scapegoat && nodeCount < kAlpha * maxCount) {
+            rebuild(&root);
+            maxCount = nodeCount;
+        }
+    }
+public:
+    explicit BasicBST(BSTBalance mode = BSTBalance::None) : balance(mode) {}
+
+    /** @throws std::length_error Если ключ не представим типом Key. */
+    void insert(std::string_view key, Value v) {
+        Probe k = insertKey<Key>(key);
+        const bool track = balance == BSTBalance::Scapegoat;
+        std::vector<Node**> path;
+        Node** link = &root;
+        while (*link) {
+            if (k == (*link)->key) {
+                (*link)->payload.push_back(v);
+                return;
+            }
+            if (track) path.push_back(link);
+            link = k < (*link)->key ? &(*link)->left : &(*link)->right;
+        }
+        Node* x = *link = newNode(k);
+        x->payload.push_back(v);
+        if (track && path.size() > depthLimit()) rebalanceAfterInsert(path, x);
+    }
+
+    /**
+     * @brief Удаляет ключ вместе со всеми пассажирами.
+     *
+     * @return size_t Сколько пассажиров удалено.
+     */
+    size_t erase(std::string_view key) {
+        Probe k;
+        if (!KeyTraits<Key>::toProbe(key, k)) return 0;
+        Node** link = findLink(k);
+        if (!*link) return 0;
+        size_t removed = (*link)->payload.size();
+        unlink(link);
+        return removed;
+    }
+
+    /**
+     * @brief Удаляет одного пассажира p с ключом key; пустой узел убирается.
+     *
+     * @return true, если p был в дереве.
+     */
+    bool erase(std::string_view key, Value p) {
+        Probe k;
+        if (!KeyTraits<Key>::toProbe(key, k)) return false;
+        Node** link = findLink(k);
+        if (!*link || !removePassenger((*link)->payload, p)) return false;
+        if ((*link)->payload.empty()) unlink(link);
+        return true;
+    }
+
+    /**
+     * @brief Заменяет запись from с ключом key на to.
+     *
+     * Если ключ у to тот же, указатель меняется на месте без перестройки
+     * дерева; иначе from удаляется, а to вставляется под своим ключом.
+     *
+     * @return true, если from был в дереве.
+     * @throws std::length_error Если новый ключ не представим типом Key.
+     */
+    bool update(std::string_view key, Value from, std::string_view toKey, Value to) {
+        if (toKey == key) {
+            Probe k;
+            if (!KeyTraits<Key>::toProbe(key, k)) return false;
+            Node* x = *findLink(k);
+            return x && replacePassenger(x->payload, from, to);
+        }
+        insertKey<Key>(toKey);
+        if (!erase(key, from)) return false;
+        insert(toKey, to);
+        return true;
+    }
+
+    // Варианты для индекса над записями Passenger
+    void insert(const Passenger& p) { insert(p.fullName, &p); }
+    bool update(std::string_view key, const Passenger* from, const Passenger& to) {
+        return update(key, from, to.fullName, &to);
+    }
+
+    View<Value> lookup(std::string_view key) const {
+        Probe k;
+        if (!KeyTraits<Key>::toProbe(key, k)) return {};
+        Node* cur = root;
+        while (cur) {
+            if (k == cur->key) return View<Value>(cur->payload);
+            cur = k < cur->key ? cur->left : cur->right;
+        }
+        return {};
+    }
+
+    std::vector<Value> search(std::string_view key) const {
+        View<Value> v = lookup(key);
+        return {v.begin(), v.end()};
+    }
+
+    /**
+     * @brief Ключи из [lo, hi] по возрастанию; обход ленивый (см. KeyRange).
+     */
+    KeyRange<Cursor> rangeSearch(std::string_view lo, std::string_view hi) const {
+        return {Cursor(root, lo), KeyBound{std::string(hi), false}};
+    }
+
+    /** @brief Ключи, начинающиеся с prefix, по возрастанию. */
+    KeyRange<Cursor> prefixSearch(std::string_view prefix) const {
+        return {Cursor(root, prefix), KeyBound{std::string(prefix), true}};
+    }
+
+    /** @brief Память узлов дерева и списка свободных узлов (см. treeMemory()). */
+    MemoryUsage memoryUsage() const { return treeMemory(root, freeNodes, arena); }
+
+    /** @brief Высота дерева (число узлов на самом длинном пути). */
+    size_t height() const { return treeHeight(root); }
+};
+
+/** @brief BST со строковыми ключами. */
+using BSTNode  = BasicBSTNode<std::string>;
+using BST      = BasicBST<std::string>;
+/** @brief BST с ключами фиксированной ширины. */
+using FixedBST = BasicBST<FixedKey>;
+
+/**
+ * @enum Color
+ * @brief Цвет узла красно-чёрного дерева.
+ */
+enum Color { RED, BLACK };
+
+/**
+ * @struct BasicRBTNode
+ * @brief Узел красно-чёрного дерева.
+ * 
+ * Содержит ключ, список указателей на объекты,
+ * цвет узла и связи на родителя и потомков.
+ * Память узла и его буферов принадлежит арене дерева.
+ *
+ * @tparam Key Представление ключа (см. KeyTraits).
+ */
+template<typename Key, typename Value = const Passenger*>
+struct BasicRBTNode {
+    typename KeyTraits<Key>::Stored    key;
+    std::pmr::vector<Value>            payload;
+    Color         color  = RED;
+    BasicRBTNode* parent = nullptr;
+    BasicRBTNode* left   = nullptr;
+    BasicRBTNode* right  = nullptr;
+
+    BasicRBTNode(typename KeyTraits<Key>::Probe k, std::pmr::memory_resource* r)
+        : key(KeyTraits<Key>::store(k, r)), payload(r) {}
+};
+
+/**
+ * @class RBTCursor
+ * @brief Позиция симметричного обхода BasicRBTree; преемник ищется по ссылкам parent.
+ */
+template<typename K, typename V>
+class RBTCursor {
+public:
+    using Key   = K;
+    using Value = V;
+    using Node  = BasicRBTNode<K, V>;
+
+    RBTCursor() = default;
+
+    /** @brief Первый узел с ключом не меньше lo. */
+    RBTCursor(const Node* root, std::string_view lo) {
+        char buf[16];
+        for (const Node* x = root; x;) {
+            if (KeyTraits<Key>::view(x->key, buf) >= lo) {
+                cur = x;
+                x = x->left;
+            } else {
+                x = x->right;
+            }
+        }
+    }
+
+    const Node* node() const { return cur; }
+    void next() {
+        if (cur->right) {
+            cur = cur->right;
+            while (cur->left) cur = cur->left;
+            return;
+        }
+        const Node* child = cur;
+        cur = cur->parent;
+        while (cur && child == cur->right) {
+            child = cur;
+            cur = cur->parent;
+        }
+    }
+private:
+    const Node* cur = nullptr;
+};
+
+/**
+ * @class BasicRBTree
+ * @brief Самобалансирующееся красно-чёрное дерево для поиска пассажиров.
+ *
+ * Удалённые узлы, как и в BasicBST, переиспользуются через список свободных.
+ *
+ * @tparam Key   Представление ключа: std::string или FixedKey.
+ * @tparam Value Ссылка на пассажира: const Passenger* или RowId (см. BasicBST).
+ */
+template<typename Key, typename Value = const Passenger*>
+class BasicRBTree {
+    using Node  = BasicRBTNode<Key, Value>;
+    using Probe = typename KeyTraits<Key>::Probe;
+public:
+    using Cursor = RBTCursor<Key, Value>;
+private:
+
+    NodeArena arena;
+    Node*     root      = nullptr;
+    Node*     freeNodes = nullptr;  /**< Список свободных узлов (через left) */
+
+    Node* newNode(const Probe& k) {
+        if (!freeNodes) return arena.make<Node>(k, arena.resource());
+        Node* x = freeNodes;
+        freeNodes = x->left;
+        KeyTraits<Key>::assign(x->key, k);
+        x->left = nullptr;
+        x->color = RED;
+        return x;
+    }
+
+    void release(Node* x) {
+        x->payload.clear();
+        x->parent = x->right = nullptr;
+        x->left   = freeNodes;
+        freeNodes = x;
+    }
+
+    Node* find(const Probe& k) const {
+        Node* cur = root;
+        while (cur && !(k == cur->key)) cur = k < cur->key ? cur->left : cur->right;
+        return cur;
+    }
+
+    static bool isBlack(const Node* x) { return !x || x->color == BLACK; }
+    //----------------------------------------
+    //  Повороты
+    void rotateLeft(Node* x) {
+        Node* y = x->right;
+        x->right = y->left;
+        if (y->left) y->left->parent = x;
+        y->parent = x->parent;
+        if (!x->parent) root = y;
+        else if (x == x->parent->left) x->parent->left = y;
+        else                           x->parent->right = y;
+        y->left = x;
+        x->parent = y;
+    }
+    void rotateRight(Node* y) {
+        Node* x = y->left;
+        y->left = x->right;
+        if (x->right) x->right->parent = y;
+        x->parent = y->parent;
+        if (!y->parent) root = x;
+        else if (y == y->parent->left) y->parent->left = x;
+        else                           y->parent->right = x;
+        x->right = y;
+        y->parent = x;
+    }
+    //----------------------------------------
+    //  Балансировка после вставки
+    void fixInsert(Node* z) {
+        while (z->parent && z->parent->color == RED) {
+            if (z->parent == z->parent->parent->left) {
+                Node* y = z->parent->parent->right; // дядя
+                if (y && y->color == RED) {
+                    z->parent->color = BLACK;
+                    y->color = BLACK;
+                    z->parent->parent->color = RED;
+                    z = z->parent->parent;
+                } else {
+                    if (z == z->parent->right) {
+                        z = z->parent;
+                        rotateLeft(z);
+                    }
+                    z->parent->color = BLACK;
+                    z->parent->parent->color = RED;
+                    rotateRight(z->parent->parent);
+                }
+            } else {
+                Node* y = z->parent->parent->left;
+                if (y && y->color == RED) {
+                    z->parent->color = BLACK;
+                    y->color = BLACK;
+                    z->parent->parent->color = RED;
+                    z = z->parent->parent;
+                } else {
+                    if (z == z->parent->left) {
+                        z = z->parent;
+                        rotateRight(z);
+                    }
+                    z->parent->color = BLACK;
+                    z->parent->parent->color = RED;
+                    rotateLeft(z->parent->parent);
+                }
+            }
+        }
+        root->color = BLACK;
+    }
+    //----------------------------------------
+    //  Удаление (Кормен и др., гл. 13.4); листья — nullptr,
+    //  поэтому родитель x передаётся отдельно
+    void transplant(Node* u, Node* v) {
+        if (!u->parent)                 root = v;
+        else if (u == u->parent->left)  u->parent->left = v;
+        else                            u->parent->right = v;
+        if (v) v->parent = u->parent;
+    }
+    void eraseNode(Node* z) {
+        Node* y = z;
+        Color yColor = y->color;
+        Node* x;
+        Node* xParent;
+        if (!z->left) {
+            x = z->right;
+            xParent = z->parent;
+            transplant(z, z->right);
+        } else if (!z->right) {
+            x = z->left;
+            xParent = z->parent;
+            transplant(z, z->left);
+        } else {
+            y = z->right;
+            while (y->left) y = y->left;     // преемник
+            yColor = y->color;
+            x = y->right;
+            if (y->parent == z) {
+                xParent = y;
+            } else {
+                xParent = y->parent;
+                transplant(y, y->right);
+                y->right = z->right;
+                y->right->parent = y;
+            }
+            transplant(z, y);
+            y->left = z->left;
+            y->left->parent = y;
+            y->color = z->color;
+        }
+        if (yColor == BLACK) fixErase(x, xParent);
+        release(z);
+    }
+    //----------------------------------------
+    //  Балансировка после удаления: x несёт «лишний» чёрный
+    void fixErase(Node* x, Node* parent) {
+        while (x != root && isBlack(x)) {
+            if (x == parent->left) {
+                Node* w = parent->right;    // брат
+                if (w->color == RED) {
+                    w->color = BLACK;
+                    parent->color = RED;
+                    rotateLeft(parent);
+                    w = parent->right;
+                }
+                if (isBlack(w->left) && isBlack(w->right)) {
+                    w->color = RED;
+                    x = parent;
+                    parent = x->parent;
+                } else {
+                    if (isBlack(w->right)) {
+                        w->left->color = BLACK;
+                        w->color = RED;
+                        rotateRight(w);
+                        w = parent->right;
+                    }
+                    w->color = parent->color;
+                    parent->color = BLACK;
+                    w->right->color = BLACK;
+                    rotateLeft(parent);
+                    x = root;
+                }
+            } else {
+                Node* w = parent->left;
+                if (w->color == RED) {
+                    w->color = BLACK;
+                    parent->color = RED;
+                    rotateRight(parent);
+                    w = parent->left;
+                }
+                if (isBlack(w->left) && isBlack(w->right)) {
+                    w->color = RED;
+                    x = parent;
+                    parent = x->parent;
+                } else {
+                    if (isBlack(w->left)) {
+                        w->right->color = BLACK;
+                        w->color = RED;
+                        rotateLeft(w);
+                        w = parent->left;
+                    }
+                    w->color = parent->color;
+                    parent->color = BLACK;
+                    w->left->color = BLACK;
+                    rotateRight(parent);
+                    x = root;
+                }
+            }
+        }
+        if (x) x->color = BLACK;
+    }
+    //----------------------------------------
+    //  Сборка поддерева из отсортированных узлов [lo, hi);
+    //  глубина рекурсии ~log n
+    static Node* link(const std::vector<Node*>& nodes, size_t lo, size_t hi,
+                         Node* parent, size_t depth, size_t redDepth) {
+        if (lo >= hi) return nullptr;
+        size_t   mid = lo + (hi - lo) / 2;
+        Node* x   = nodes[mid];
+        x->parent = parent;
+        x->color  = depth == redDepth ? RED : BLACK;
+        x->left   = link(nodes, lo, mid, x, depth + 1, redDepth);
+        x->right  = link(nodes, mid + 1, hi, x, depth + 1, redDepth);
+        return x;
+    }
+public:
+    /** @throws std::length_error Если ключ не представим типом Key. */
+    void insert(std::string_view key, Value v) {
+        // обычная BST вставка
+        Probe k = insertKey<Key>(key);
+        Node* y = nullptr;
+        Node* x = root;
+        while (x) {
+            y = x;
+            if (k == x->key) {
+                x->payload.push_back(v);
+                return; // ключ уже есть
+            }
+            x = (k < x->key) ? x->left : x->right;
+        }
+        Node* z = newNode(k);
+        z->payload.push_back(v);
+        z->parent = y;
+        if (!y)               root = z;
+        else if (k < y->key)  y->left  = z;
+        else                  y->right = z;
+        z->color = RED;
+        fixInsert(z);
+    }
+
+    /**
+     * @brief Строит дерево из data сортировкой и сборкой сбалансированного дерева.
+     *
+     * Записи упорядочиваются sortByKey(), одинаковые ключи сворачиваются
+     * в один узел,
+     * и дерево собирается из середин отрезков без единого поворота.
+     * Узлы последнего неполного уровня красные, остальные чёрные, поэтому
+     * чёрная высота всех путей одинакова. В непустое дерево записи
+     * добавляются обычным insert().
+     */
+    void bulkBuild(const std::vector<Passenger>& data, ThreadPool& pool) {
+        if (root) {
+            for (const auto& p : data) insert(p);
+            return;
+        }
+        const size_t n = data.size();
+        std::vector<SortItem> items = sortByKey(data, pool);
+
+        std::vector<Node*> nodes;
+        for (size_t i = 0; i < n;) {
+            size_t j = i + 1;
+            while (j < n && sameKey(items[i], items[j], data)) ++j;
+            Node* z = newNode(insertKey<Key>(data[items[i].idx].fullName));
+            z->payload.reserve(j - i);
+            for (size_t k = i; k < j; ++k) z->payload.push_back(&data[items[k].idx]);
+            nodes.push_back(z);
+            i = j;
+        }
+        size_t levels = 0;
+        while ((size_t(1) << levels) - 1 < nodes.size()) ++levels;
+        size_t redDepth = (size_t(1) << levels) - 1 == nodes.size() ? SIZE_MAX : levels - 1;
+        root = link(nodes, 0, nodes.size(), nullptr, 0, redDepth);
+    }
+
+    /**
+     * @brief Удаляет ключ вместе со всеми пассажирами.
+     *
+     * @return size_t Сколько пассажиров удалено.
+     */
+    size_t erase(std::string_view key) {
+        Probe k;
+        if (!KeyTraits<Key>::toProbe(key, k)) return 0;
+        Node* z = find(k);
+        if (!z) return 0;
+        size_t removed = z->payload.size();
+        eraseNode(z);
+        return removed;
+    }
+
+    /**
+     * @brief Удаляет одного пассажира p с ключом key; пустой узел убирается.
+     *
+     * @return true, если p был в дереве.
+     */
+    bool erase(std::string_view key, Value p) {
+        Probe k;
+        if (!KeyTraits<Key>::toProbe(key, k)) return false;
+        Node* z = find(k);
+        if (!z || !removePassenger(z->payload, p)) return false;
+        if (z->payload.empty()) eraseNode(z);
+        return true;
+    }
+
+    /**
+     * @brief Заменяет запись from с ключом key на to.
+     *
+     * Если ключ у to тот же, указатель меняется на месте без перестройки
+     * дерева; иначе from удаляется, а to вставляется под своим ключом.
+     *
+     * @return true, если from был в дереве.
+     * @throws std::length_error Если новый ключ не представим типом Key.
+     */
+    bool update(std::string_view key, Value from, std::string_view toKey, Value to) {
+        if (toKey == key) {
+            Probe k;
+            if (!KeyTraits<Key>::toProbe(key, k)) return false;
+            Node* z = find(k);
+            return z && replacePassenger(z->payload, from, to);
+        }
+        insertKey<Key>(toKey);
+        if (!erase(key, from)) return false;
+        insert(toKey, to);
+        return true;
+    }
+
+    // Варианты для индекса над записями Passenger
+    void insert(const Passenger& p) { insert(p.fullName, &p); }
+    bool update(std::string_view key, const Passenger* from, const Passenger& to) {
+        return update(key, from, to.fullName, &to);
+    }
+
+    View<Value> lookup(std::string_view key) const {
+        Probe k;
+        if (!KeyTraits<Key>::toProbe(key, k)) return {};
+        const Node* z = find(k);
+        return z ? View<Value>(z->payload) : View<Value>();
+    }
+
+    /**
+     * @brief Пакетный поиск: results[i] — ответ на keys[i], как у lookup().
+     *
+     * До group спусков идут одновременно (interleaveLookups): шаг сравнивает
+     * ключ в узле, уже запрошенном в кеш, и запрашивает выбранного потомка.
+     */
+    void lookupBatch(View<std::string> keys, std::vector<View<Value>>& results,
+                     size_t group = kLookupGroup) const {
+        struct Lane {
+            const Node* node = nullptr;
+            Probe       key{};
+            size_t      idx  = 0;
+        };
+        results.assign(keys.size(), View<Value>());
+        interleaveLookups<Lane>(keys.size(), group,
+            [&](Lane& l, size_t i) {
+                if (!root || !KeyTraits<Key>::toProbe(keys[i], l.key)) return false;
+                l.node = root;
+                l.idx  = i;
+                prefetchObject(root);
+                return true;
+            },
+            [&](Lane& l) {
+                const Node* x = l.node;
+                if (l.key == x->key) {
+                    results[l.idx] = View<Value>(x->payload);
+                    return true;
+                }
+                x = l.key < x->key ? x->left : x->right;
+                if (!x) return true;
+                prefetchObject(x);
+                l.node = x;
+                return false;
+            });
+    }
+
+    std::vector<Value> search(std::string_view key) const {
+        View<Value> v = lookup(key);
+        return {v.begin(), v.end()};
+    }
+
+    /**
+     * @brief Ключи из [lo, hi] по возрастанию; обход ленивый (см. KeyRange).
+     */
+    KeyRange<Cursor> rangeSearch(std::string_view lo, std::string_view hi) const {
+        return {Cursor(root, lo), KeyBound{std::string(hi), false}};
+    }
+
+    /** @brief Ключи, начинающиеся с prefix, по возрастанию. */
+    KeyRange<Cursor> prefixSearch(std::string_view prefix) const {
+        return {Cursor(root, prefix), KeyBound{std::string(prefix), true}};
+    }
+
+    /** @brief Высота дерева (число узлов на самом длинном пути). */
+    size_t height() const { return treeHeight(root); }
+
+    /** @brief Память узлов дерева и списка свободных узлов (см. treeMemory()). */
+    MemoryUsage memoryUsage() const { return treeMemory(root, freeNodes, arena); }
+};
+
+/** @brief Красно-чёрное дерево со строковыми ключами. */
+using RBTNode     = BasicRBTNode<std::string>;
+using RBTree      = BasicRBTree<std::string>;
+/** @brief Красно-чёрное дерево с ключами фиксированной ширины. */
+using FixedRBTree = BasicRBTree<FixedKey>;
+/** @brief Красно-чёрное дерево над PassengerStore: в узлах номера строк. */
+using RowRBTree   = BasicRBTree<std::string, RowId>;
+
+/**
+ * @class BasicRadixTrie
+ * @brief Сжатое префиксное дерево (radix tree) по байтам ключа.
+ *
+ * Цепочки узлов с единственным потомком свёрнуты в метку label: ребро
+ * в узел — байт ветвления у родителя и затем label. Потомки узла лежат
+ * плотным массивом по возрастанию байта, а какие байты есть, отмечает
+ * 256-битная маска: номер потомка — число единиц маски до байта
+ * (popcount), поэтому узел с двумя потомками не тратит 256 указателей.
+ * Поиск точного ключа и префикса — O(длина ключа) сравнений, не зависит
+ * от числа записей; общие префиксы имён хранятся один раз.
+ *
+ * Узлы, метки, массивы потомков и списки пассажиров берут память из арены
+ * дерева. Ключ в узле не хранится целиком, поэтому обход префикса
+ * отдаёт только пассажиров (см. PrefixRange).
+ *
+ * @tparam Value Ссылка на пассажира: const Passenger* или RowId (см. BasicBST).
+ */
+template<typename Value = const Passenger*>
+class BasicRadixTrie {
+    struct Node {
+        std::pmr::string         label;         /**< Байты ребра после байта ветвления */
+        std::pmr::vector<Value>  payload;       /**< Пусто — ключ здесь не заканчивается */
+        std::pmr::vector<Node*>  children;      /**< По возрастанию байта */
+        uint64_t                 bits[4] = {};  /**< Маска байтов потомков */
+
+        Node(std::string_view l, std::pmr::memory_resource* r)
+            : label(l, r), payload(r), children(r) {}
+
+        bool has(unsigned char c) const { return bits[c >> 6] >> (c & 63) & 1; }
+        size_t rank(unsigned char c) const {
+            size_t r = 0;
+            for (size_t w = 0; w < size_t(c >> 6); ++w) r += __builtin_popcountll(bits[w]);
+            return r + __builtin_popcountll(bits[c >> 6] & ((uint64_t(1) << (c & 63)) - 1));
+        }
+        Node* child(unsigned char c) const { return has(c) ? children[rank(c)] : nullptr; }
+        void addChild(unsigned char c, Node* x) {
+            children.insert(children.begin() + rank(c), x);
+            bits[c >> 6] |= uint64_t(1) << (c & 63);
+        }
+    };
+
+    NodeArena arena;
+    Node*     root;
+    size_t    keyCount  = 0;
+    size_t    nodeCount = 1;
+
+    Node* newNode(std::string_view label) {
+        ++nodeCount;
+        return arena.make<Node>(label, arena.resource());
+    }
+
+    // Делит ребро в x после m байт метки: хвост с содержимым x уходит в потомка
+    void split(Node* x, size_t m) {
+        Node* y = newNode(std::string_view(x->label).substr(m + 1));
+        y->payload.swap(x->payload);
+        y->children.swap(x->children);
+        std::copy(std::begin(x->bits), std::end(x->bits), std::begin(y->bits));
+        const unsigned char c = static_cast<unsigned char>(x->label[m]);
+        x->label.resize(m);
+        std::fill(std::begin(x->bits), std::end(x->bits), 0);
+        x->addChild(c, y);
+    }
+
+    // Узел, под которым лежат все ключи с префиксом p, или nullptr
+    const Node* findPrefix(std::string_view p) const {
+        const Node* x = root;
+        for (size_t i = 0;;) {
+            const size_t rest = p.size() - i;
+            const size_t m = std::min(rest, x->label.size());
+            if (p.compare(i, m, x->label, 0, m) != 0) return nullptr;
+            if (rest <= x->label.size()) return x;
+            i += x->label.size();
+            if (!(x = x->child(static_cast<unsigned char>(p[i++])))) return nullptr;
+        }
+    }
+public:
+    /**
+     * @class PrefixRange
+     * @brief Пассажиры поддерева в порядке ключей: обход в глубину, потомки по возрастанию байта.
+     *
+     * Ключ узла меньше ключей его потомков, поэтому прямой порядок обхода
+     * совпадает с лексикографическим. Пока обход не закончен, дерево
+     * менять нельзя.
+     */
+    class PrefixRange {
+        const Node* top;
+    public:
+        class iterator {
+            std::vector<const Node*> stack;     // ещё не посещённые узлы; вершина — следующий
+
+            void settle() {
+                while (!stack.empty()) {
+                    const Node* x = stack.back();
+                    if (!x->payload.empty()) return;
+                    stack.pop_back();
+                    stack.insert(stack.end(), x->children.rbegin(), x->children.rend());
+                }
+            }
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type        = View<Value>;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = void;
+            using reference         = View<Value>;
+
+            iterator() = default;
+            explicit iterator(const Node* x) {
+                if (x) stack.push_back(x);
+                settle();
+            }
+
+            View<Value> operator*() const { return View<Value>(stack.back()->payload); }
+            iterator& operator++() {
+                const Node* x = stack.back();
+                stack.pop_back();
+                stack.insert(stack.end(), x->children.rbegin(), x->children.rend());
+                settle();
+                return *this;
+            }
+            bool operator==(const iterator& o) const {
+                return stack.empty() ? o.stack.empty() : !o.stack.empty() && stack.back() == o.stack.back();
+            }
+            bool operator!=(const iterator& o) const { return !(*this == o); }
+        };
+
+        explicit PrefixRange(const Node* x) : top(x) {}
+
+        iterator begin() const { return iterator(top); }
+        iterator end() const   { return iterator(); }
+
+        /** @brief Число пассажиров в поддереве. */
+        size_t count() const {
+            size_t n = 0;
+            for (View<Value> v : *this) n += v.size();
+            return n;
+        }
+        /** @brief Все пассажиры поддерева в порядке ключей. */
+        std::vector<Value> collect() const {
+            std::vector<Value> out;
+            for (View<Value> v : *this) out.insert(out.end(), v.begin(), v.end());
+            return out;
+        }
+    };
+
+    BasicRadixTrie() : root(arena.make<Node>(std::string_view(), arena.resource())) {}
+    BasicRadixTrie(const BasicRadixTrie&) = delete;
+    BasicRadixTrie& operator=(const BasicRadixTrie&) = delete;
+
+    void insert(std::string_view key, Value v) {
+        Node* x = root;
+        for (size_t i = 0;;) {
+            const std::string_view label = x->label;
+            size_t m = 0;
+            while (m < label.size() && i + m < key.size() && label[m] == key[i + m]) ++m;
+            if (m < label.size()) split(x, m);
+            i += m;
+            if (i == key.size()) break;
+            const unsigned char c = static_cast<unsigned char>(key[i++]);
+            Node* next = x->child(c);
+            if (!next) {
+                next = newNode(key.substr(i));
+                x->addChild(c, next);
+                x = next;
+                break;
+            }
+            x = next;
+        }
+        keyCount += x->payload.empty();
+        x->payload.push_back(v);
+    }
+
+    void insert(const Passenger& p) { insert(p.fullName, &p); }
+
+    View<Value> lookup(std::string_view key) const {
+        const Node* x = root;
+        for (size_t i = 0;;) {
+            const std::string_view label = x->label;
+            if (key.size() - i < label.size() || key.compare(i, label.size(), label) != 0)
+                return {};
+            i += label.size();
+            if (i == key.size()) return View<Value>(x->payload);
+            if (!(x = x->child(static_cast<unsigned char>(key[i++])))) return {};
+        }
+    }
+
+    std::vector<Value> search(std::string_view key) const {
+        View<Value> v = lookup(key);
+        return {v.begin(), v.end()};
+    }
+
+    /** @brief Ключи, начинающиеся с prefix, по возрастанию. */
+    PrefixRange prefixSearch(std::string_view prefix) const {
+        return PrefixRange(findPrefix(prefix));
+    }
+
+    /** @brief Число различных ключей. */
+    size_t size() const { return keyCount; }
+    /** @brief Число узлов вместе с корнем. */
+    size_t nodes() const { return nodeCount; }
+
+    /** @brief Обходит дерево (без рекурсии) и считает занимаемую память. */
+    MemoryUsage memoryUsage() const {
+        MemoryUsage m;
+        std::vector<const Node*> stack{root};
+        while (!stack.empty()) {
+            const Node* x = stack.back();
+            stack.pop_back();
+            m.nodes   += sizeof(Node) + x->children.capacity() * sizeof(Node*);
+            m.payload += x->payload.capacity() * sizeof(Value);
+            m.keys    += stringHeapBytes(x->label);
+            stack.insert(stack.end(), x->children.begin(), x->children.end());
+        }
+        m.arena = arena.reservedBytes();
+        return m;
+    }
+};
+
+/** @brief Сжатое префиксное дерево со строковыми ключами. */
+using RadixTrie = BasicRadixTrie<>;
+
+/** @brief 128-битное беззнаковое целое GCC/Clang; __extension__ снимает -Wpedantic. */
+__extension__ typedef unsigned __int128 UInt128;
+
+/**
+ * @brief Сводит 64-битный хеш к диапазону [0, n) умножением (fastrange, Lemire).
+ *
+ * Заменяет деление по модулю; использует старшие биты хеша.
+ */
+inline size_t fastRange(uint64_t h, size_t n) {
+    return static_cast<size_t>((static_cast<UInt128>(h) * n) >> 64);
+}
+
+/**
+ * @struct PolyHash
+ * @brief Полиномиальный rolling-hash h = h * 31 + c (прежний HashTable::hashStr).
+ *
+ * Модуль берётся один раз на ключ, а не на каждый символ; для ключей
+ * до 10 символов значение не переполняет 64 бита, и номер корзины совпадает
+ * с прежним. Старшие биты у такого хеша почти пусты, поэтому fastrange
+ * для него не годится — сведение выполняется остатком.
+ */
+struct PolyHash {
+    uint64_t seed = 0;   /**< Начальное значение аккумулятора */
+
+    uint64_t operator()(std::string_view s) const {
+        const uint64_t P = 31;
+        uint64_t h = seed;
+        for (char c : s) h = h * P + static_cast<uint64_t>(c);
+        return h;
+    }
+    static size_t reduce(uint64_t h, size_t n) { return static_cast<size_t>(h % n); }
+};
+
+/**
+ * @struct WyHash
+ * @brief Быстрый 64-битный хеш wyhash (final v4) с сидом.
+ *
+ * Обрабатывает ключ словами по 4–8 байт, все биты результата хорошо
+ * перемешаны, поэтому к номеру корзины сводится через fastRange.
+ */
+struct WyHash {
+    uint64_t seed = 0;   /**< Сид хеш-функции */
+
+    uint64_t operator()(std::string_view s) const {
+        return hash(s.data(), s.size(), seed);
+    }
+    static size_t reduce(uint64_t h, size_t n) { return fastRange(h, n); }
+
+    static uint64_t hash(const void* key, size_t len, uint64_t seed) {
+        static constexpr uint64_t secret[4] = {
+            0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+            0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+        };
+        const uint8_t* p = static_cast<const uint8_t*>(key);
+        seed ^= mix(seed ^ secret[0], secret[1]);
+        uint64_t a, b;
+        if (len <= 16) {
+            if (len >= 4) {
+                a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+                b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+            } else if (len > 0) {
+                a = (uint64_t(p[0]) << 16) | (uint64_t(p[len >> 1]) << 8) | p[len - 1];
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            size_t i = len;
+            if (i > 48) {
+                uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+                    see1 = mix(read8(p + 16) ^ secret[2], read8(p + 24) ^ see1);
+                    see2 = mix(read8(p + 32) ^ secret[3], read8(p + 40) ^ see2);
+                    p += 48; i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16) {
+                seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+                i -= 16; p += 16;
+            }
+            a = read8(p + i - 16);
+            b = read8(p + i - 8);
+        }
+        a ^= secret[1];
+        b ^= seed;
+        mum(a, b);
+        return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+    }
+private:
+    static void mum(uint64_t& a, uint64_t& b) {
+        UInt128 r = static_cast<UInt128>(a) * b;
+        a = static_cast<uint64_t>(r);
+        b = static_cast<uint64_t>(r >> 64);
+    }
+    static uint64_t mix(uint64_t a, uint64_t b) { mum(a, b); return a ^ b; }
+    static uint64_t read8(const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+    static uint64_t read4(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+};
+
+/**
+ * @struct HashStats
+ * @brief Распределение ключей хеш-таблицы по корзинам и средняя цена поиска.
+ *
+ * Для таблиц с цепочками histogram[L] — число корзин с цепочкой из L ключей;
+ * для открытой адресации — число ключей, найденных за L проб. Пробы
+ * считаются в сравнениях с узлами / слотами: успешный поиск ключа на месте L
+ * цепочки стоит L проб, неуспешный — всю цепочку корзины.
+ */
+struct HashStats {
+    size_t keys         = 0;    /**< Различных ключей */
+    size_t buckets      = 0;    /**< Корзин / слотов */
+    size_t emptyBuckets = 0;    /**< Пустых корзин / слотов */
+    size_t collisions   = 0;    /**< Ключей, не попавших первыми в свою корзину */
+    size_t maxChain     = 0;    /**< Самая длинная цепочка / пробирование */
+    double loadFactor    = 0;   /**< keys / buckets */
+    double avgProbesHit  = 0;   /**< Среднее число проб успешного поиска */
+    double avgProbesMiss = 0;   /**< Среднее число проб неуспешного поиска */
+    std::vector<size_t> histogram;  /**< См. описание структуры */
+
+    /** @brief Статистика таблицы с цепочками по гистограмме длин цепочек. */
+    static HashStats fromChains(std::vector<size_t> chains) {
+        HashStats s;
+        double hitProbes = 0;
+        for (size_t len = 0; len < chains.size(); ++len) {
+            s.buckets += chains[len];
+            s.keys    += len * chains[len];
+            hitProbes += 0.5 * len * (len + 1) * chains[len];
+            if (chains[len]) s.maxChain = len;
+        }
+        chains.resize(s.maxChain + 1);
+        s.emptyBuckets = chains[0];
+        s.collisions   = s.keys - (s.buckets - s.emptyBuckets);
+        s.loadFactor   = s.buckets ? double(s.keys) / s.buckets : 0;
+        s.avgProbesHit  = s.keys ? hitProbes / s.keys : 0;
+        s.avgProbesMiss = s.loadFactor;
+        s.histogram     = std::move(chains);
+        return s;
+    }
+};
+
+/**
+ * @class BasicHashTable
+ * @brief Хеш-таблица с цепочками для хранения пассажиров по ключу.
+ *
+ * Хеш-функция задаётся политикой: объект с operator()(std::string_view),
+ * возвращающим 64-битный хеш, и статическим reduce(h, n), сводящим его
+ * к номеру корзины. Полный хеш хранится в корзине: по нему сначала
+ * отсеиваются чужие ключи цепочки, и его не нужно пересчитывать.
+ * Корзины размещаются в арене таблицы и освобождаются вместе с ней.
+ *
+ * Когда число различных ключей превышает maxLoadFactor() * bucketCount(),
+ * таблица начинает расти примерно вдвое. Перехеширование инкрементное:
+ * каждая следующая вставка переносит несколько корзин старой таблицы
+ * в новую, поэтому ни одна вставка не платит за полный проход. Пока
+ * перенос не завершён, поиск смотрит в обе таблицы. Удалённые корзины
+ * переиспользуются через список свободных; после массового удаления
+ * таблицу можно сжать shrink_to_fit().
+ *
+ * @tparam Hash  Политика хеширования (PolyHash, WyHash).
+ * @tparam Value Ссылка на пассажира: const Passenger* или RowId (см. BasicBST).
+ */
+template<typename Hash, typename Value = const Passenger*>
+class BasicHashTable {
+    struct Bucket {
+        std::pmr::string       key;
+        uint64_t               hash = 0;
+        std::pmr::vector<Value> payload;
+        Bucket* next = nullptr;
+
+        Bucket(std::string_view k, uint64_t h, std::pmr::memory_resource* r)
+            : key(k, r), hash(h), payload(r) {}
+    };
+
+    /** @brief Сколько корзин старой таблицы переносит одна вставка. */
+    static constexpr size_t kRehashStep = 4;
+
+    NodeArena            arena;
+    std::vector<std::unique_ptr<NodeArena>> bulkArenas;  /**< Арены потоков bulkBuild() */
+    std::vector<Bucket*> table;       /**< Основная таблица; во время роста — старая */
+    std::vector<Bucket*> target;      /**< Новая таблица, пока идёт перехеширование */
+    size_t               migrated = 0;  /**< Сколько корзин table уже перенесено в target */
+    size_t               keyCount = 0;
+    Bucket*              freeBuckets = nullptr;  /**< Список свободных корзин (через next) */
+    double               maxLoad;
+    size_t               collisions = 0;
+    Hash                 hasher;
+
+    bool rehashing() const { return !target.empty(); }
+
+    static Bucket* find(Bucket* cur, uint64_t h, std::string_view k) {
+        for (; cur; cur = cur->next)
+            if (cur->hash == h && cur->key == k) return cur;
+        return nullptr;
+    }
+
+    /** @brief Итог вставки одной записи. */
+    struct Inserted {
+        bool collided;  /**< Корзина уже была занята (в том числе этим же ключом) */
+        bool newKey;    /**< Создан новый узел */
+    };
+
+    Bucket* newBucket(std::string_view k, uint64_t h) {
+        if (!freeBuckets) return arena.make<Bucket>(k, h, arena.resource());
+        Bucket* b = freeBuckets;
+        freeBuckets = b->next;
+        b->key.assign(k.data(), k.size());
+        b->hash = h;
+        b->next = nullptr;
+        return b;
+    }
+
+    void release(Bucket* b) {
+        b->payload.clear();
+        b->next = freeBuckets;
+        freeBuckets = b;
+    }
+
+    // Вставка с готовым хешем в таблицу tab; make(k, h) создаёт новую корзину
+    template<typename Make>
+    static Inserted insertHashed(std::vector<Bucket*>& tab, std::string_view k, Value v,
+                                 uint64_t h, Make&& make) {
+        size_t idx = Hash::reduce(h, tab.size());
+        Bucket* cur = tab[idx];
+        if (!cur) {
+            tab[idx] = make(k, h);
+            tab[idx]->payload.push_back(v);
+            return {false, true};
+        }
+        // цепочка существует => коллизия
+        Bucket* prev = nullptr;
+        while (cur) {
+            if (cur->hash == h && cur->key == k) {
+                cur->payload.push_back(v);
+                return {true, false};
+            }
+            prev = cur;
+            cur = cur->next;
+        }
+        prev->next = make(k, h);
+        prev->next->payload.push_back(v);
+        return {true, true};
+    }
+
+    // Ссылка на корзину ключа в цепочке; *результат == nullptr, если ключа нет
+    Bucket** findLink(uint64_t h, std::string_view k) {
+        auto scan = [&](Bucket** link) {
+            while (*link && !((*link)->hash == h && (*link)->key == k)) link = &(*link)->next;
+            return link;
+        };
+        if (!rehashing()) return scan(&table[Hash::reduce(h, table.size())]);
+        Bucket** link = scan(&target[Hash::reduce(h, target.size())]);
+        size_t old = Hash::reduce(h, table.size());
+        return *link || old < migrated ? link : scan(&table[old]);
+    }
+
+    void unlink(Bucket** link) {
+        Bucket* b = *link;
+        *link = b->next;
+        release(b);
+        --keyCount;
+    }
+
+    // Переносит до steps корзин из table в target; по окончании target становится table
+    void rehashStep(size_t steps) {
+        for (; steps && migrated < table.size(); --steps, ++migrated) {
+            Bucket* cur = table[migrated];
+            table[migrated] = nullptr;
+            while (cur) {
+                Bucket* next = cur->next;
+                Bucket*& head = target[Hash::reduce(cur->hash, target.size())];
+                cur->next = head;
+                head = cur;
+                cur = next;
+            }
+        }
+        if (migrated == table.size()) {
+            table.swap(target);
+            target = std::vector<Bucket*>();
+            migrated = 0;
+        }
+    }
+
+    void finishRehash() {
+        if (rehashing()) rehashStep(table.size());
+    }
+
+    // Немедленно переносит все узлы в таблицу из nBuckets корзин
+    void rehashTo(size_t nBuckets) {
+        finishRehash();
+        target.assign(std::max<size_t>(nBuckets, 1), nullptr);
+        rehashStep(table.size());
+    }
+
+    size_t bucketsFor(size_t keys) const {
+        return static_cast<size_t>(std::ceil(static_cast<double>(keys) / maxLoad));
+    }
+
+    // Число различных значений hashes: куски сортируются потоками и сливаются парами
+    static size_t distinctHashes(std::vector<uint64_t> hashes, ThreadPool& pool) {
+        const size_t T = pool.size(), n = hashes.size();
+        auto at = [&](size_t c) { return hashes.begin() + n * std::min(c, T) / T; };
+        pool.run([&](size_t c) { std::sort(at(c), at(c + 1)); });
+        for (size_t w = 1; w < T; w *= 2)
+            pool.run([&](size_t c) {
+                if (c % (2 * w) == 0 && c + w < T) std::inplace_merge(at(c), at(c + w), at(c + 2 * w));
+            });
+        return static_cast<size_t>(std::unique(hashes.begin(), hashes.end()) - hashes.begin());
+    }
+
+    void startGrowIfNeeded() {
+        if (!rehashing() && keyCount > maxLoad * table.size()) {
+            target.assign(table.size() * 2 + 1, nullptr);
+            migrated = 0;
+        }
+    }
+public:
+    /**
+     * @param nBuckets      Начальное число корзин (не меньше 1).
+     * @param hash          Объект хеш-функции.
+     * @param maxLoadFactor Допустимое число ключей на корзину до роста.
+     */
+    explicit BasicHashTable(size_t nBuckets = 16, Hash hash = Hash{},
+                            double maxLoadFactor = 1.0)
+        : table(std::max<size_t>(nBuckets, 1), nullptr), maxLoad(maxLoadFactor),
+          hasher(hash) {}
+
+    void insert(std::string_view key, Value v) {
+        uint64_t h = hasher(key);
+        auto make = [this](std::string_view k, uint64_t hk) { return newBucket(k, hk); };
+        Inserted r;
+        if (rehashing()) {
+            rehashStep(kRehashStep);
+        }
+        if (rehashing()) {
+            // ключ может лежать в ещё не перенесённой корзине старой таблицы
+            size_t old = Hash::reduce(h, table.size());
+            Bucket* b = old >= migrated ? find(table[old], h, key) : nullptr;
+            if (b) {
+                b->payload.push_back(v);
+                r = {true, false};
+            } else {
+                r = insertHashed(target, key, v, h, make);
+            }
+        } else {
+            r = insertHashed(table, key, v, h, make);
+        }
+        collisions += r.collided && r.newKey;
+        if (r.newKey) {
+            ++keyCount;
+            startGrowIfNeeded();
+        }
+    }
+
+    /**
+     * @brief Параллельно вставляет все записи data.
+     *
+     * Параллельно строится только пустая таблица: списки пассажиров
+     * существующих корзин живут в общей арене, а она не потокобезопасна,
+     * поэтому в непустую таблицу записи вставляются последовательно.
+     *
+     * Незавершённое перехеширование сначала доводится до конца. Потоки
+     * считают хеши своих кусков данных; если таблице может не хватить
+     * корзин, она расширяется под число различных хешей. Затем записи
+     * раскладываются по pool.size() непересекающимся диапазонам корзин
+     * с сохранением исходного порядка. Каждый поток вставляет только в свой
+     * диапазон и в свою арену, поэтому блокировки не нужны, а результат
+     * совпадает с последовательной вставкой data. Список свободных корзин
+     * здесь не используется.
+     */
+    void bulkBuild(const std::vector<Passenger>& data, ThreadPool& pool) {
+        if (keyCount != 0) {
+            for (const Passenger& p : data) insert(p);
+            return;
+        }
+        finishRehash();
+        const size_t T = pool.size(), n = data.size();
+        while (bulkArenas.size() + 1 < T) bulkArenas.push_back(std::make_unique<NodeArena>());
+        std::vector<uint64_t> hashes(n);
+        pool.run([&](size_t c) {
+            for (size_t i = n * c / T; i < n * (c + 1) / T; ++i) hashes[i] = hasher(data[i].fullName);
+        });
+        if (bucketsFor(n) > table.size()) reserve(distinctHashes(hashes, pool));
+
+        const size_t B = table.size();
+        auto part = [&](uint64_t h) { return Hash::reduce(h, B) * T / B; };
+        std::vector<size_t> counts(T * T, 0);     // counts[кусок * T + диапазон]
+        pool.run([&](size_t c) {
+            size_t* cnt = &counts[c * T];
+            for (size_t i = n * c / T; i < n * (c + 1) / T; ++i) ++cnt[part(hashes[i])];
+        });
+        // диапазон t занимает [partBegin[t], partBegin[t+1]), внутри — куски по порядку
+        std::vector<size_t> offsets(T * T), partBegin(T + 1);
+        size_t pos = 0;
+        for (size_t t = 0; t < T; ++t) {
+            partBegin[t] = pos;
+            for (size_t c = 0; c < T; ++c) {
+                offsets[c * T + t] = pos;
+                pos += counts[c * T + t];
+            }
+        }
+        partBegin[T] = pos;
+        std::vector<size_t> order(n);
+        pool.run([&](size_t c) {
+            size_t* off = &offsets[c * T];
+            for (size_t i = n * c / T; i < n * (c + 1) / T; ++i) order[off[part(hashes[i])]++] = i;
+        });
+        std::vector<size_t> colls(T, 0), keys(T, 0);
+        pool.run([&](size_t t) {
+            NodeArena& a = t == 0 ? arena : *bulkArenas[t - 1];
+            auto make = [&a](std::string_view k, uint64_t h) {
+                return a.make<Bucket>(k, h, a.resource());
+            };
+            for (size_t j = partBegin[t]; j < partBegin[t + 1]; ++j) {
+                const Passenger& p = data[order[j]];
+                Inserted r = insertHashed(table, p.fullName, &p, hashes[order[j]], make);
+                colls[t] += r.collided && r.newKey;
+                keys[t]  += r.newKey;
+            }
+        });
+        for (size_t t = 0; t < T; ++t) {
+            collisions += colls[t];
+            keyCount   += keys[t];
+        }
+        startGrowIfNeeded();      // совпадения хешей разных ключей могли занизить оценку
+    }
+
+    /**
+     * @brief Удаляет ключ вместе со всеми пассажирами.
+     *
+     * Таблица при этом не сжимается; см. shrink_to_fit().
+     *
+     * @return size_t Сколько пассажиров удалено.
+     */
+    size_t erase(std::string_view key) {
+        Bucket** link = findLink(hasher(key), key);
+        if (!*link) return 0;
+        size_t removed = (*link)->payload.size();
+        unlink(link);
+        return removed;
+    }
+
+    /**
+     * @brief Удаляет одного пассажира p с ключом key; пустая корзина убирается.
+     *
+     * @return true, если p был в таблице.
+     */
+    bool erase(std::string_view key, Value p) {
+        Bucket** link = findLink(hasher(key), key);
+        if (!*link || !removePassenger((*link)->payload, p)) return false;
+        if ((*link)->payload.empty()) unlink(link);
+        return true;
+    }
+
+    /**
+     * @brief Заменяет запись from с ключом key на to.
+     *
+     * Если ключ у to тот же, указатель меняется на месте; иначе from
+     * удаляется, а to вставляется под своим ключом.
+     *
+     * @return true, если from был в таблице.
+     */
+    bool update(std::string_view key, Value from, std::string_view toKey, Value to) {
+        if (toKey == key) {
+            Bucket* b = *findLink(hasher(key), key);
+            return b && replacePassenger(b->payload, from, to);
+        }
+        if (!erase(key, from)) return false;
+        insert(toKey, to);
+        return true;
+    }
+
+    // Варианты для индекса над записями Passenger
+    void insert(const Passenger& p) { insert(p.fullName, &p); }
+    bool update(std::string_view key, const Passenger* from, const Passenger& to) {
+        return update(key, from, to.fullName, &to);
+    }
+
+    /**
+     * @brief Гарантирует место под nKeys различных ключей без роста.
+     *
+     * Доводит до конца текущее перехеширование и, если корзин не хватает,
+     * сразу переносит все узлы в таблицу нужного размера.
+     */
+    void reserve(size_t nKeys) {
+        finishRehash();
+        size_t need = bucketsFor(nKeys);
+        if (need > table.size()) rehashTo(need);
+    }
+
+    /**
+     * @brief Уменьшает таблицу до минимального размера при текущем числе ключей.
+     */
+    void shrink_to_fit() {
+        finishRehash();
+        size_t need = std::max<size_t>(bucketsFor(keyCount), 1);
+        if (need < table.size()) rehashTo(need);
+        table.shrink_to_fit();
+    }
+
+    /** @brief Меняет порог роста; применяется со следующей вставки. */
+    void setMaxLoadFactor(double f) { maxLoad = f; }
+    double maxLoadFactor() const { return maxLoad; }
+
+    /** @brief Число корзин; во время роста — размер новой таблицы. */
+    size_t bucketCount() const { return rehashing() ? target.size() : table.size(); }
+    double loadFactor() const { return static_cast<double>(keyCount) / bucketCount(); }
+    /** @brief Число различных ключей. */
+    size_t size() const { return keyCount; }
+
+    View<Value> lookup(std::string_view key) const {
+        uint64_t h = hasher(key);
+        if (rehashing()) {
+            if (const Bucket* b = find(target[Hash::reduce(h, target.size())], h, key))
+                return View<Value>(b->payload);
+            size_t old = Hash::reduce(h, table.size());
+            if (old < migrated) return {};
+            const Bucket* b = find(table[old], h, key);
+            return b ? View<Value>(b->payload) : View<Value>();
+        }
+        const Bucket* b = find(table[Hash::reduce(h, table.size())], h, key);
+        return b ? View<Value>(b->payload) : View<Value>();
+    }
+
+    /**
+     * @brief Пакетный поиск: results[i] — ответ на keys[i], как у lookup().
+     *
+     * До group запросов идут одновременно (interleaveLookups): первый шаг
+     * читает запрошенную в кеш ячейку таблицы и запрашивает голову цепочки,
+     * следующие проверяют корзину и запрашивают её преемника. Во время
+     * перехеширования запросы выполняются по одному через lookup().
+     */
+    void lookupBatch(View<std::string> keys, std::vector<View<Value>>& results,
+                     size_t group = kLookupGroup) const {
+        results.resize(keys.size());
+        if (rehashing() || table.empty()) {
+            for (size_t i = 0; i < keys.size(); ++i) results[i] = lookup(keys[i]);
+            return;
+        }
+        struct Lane {
+            const Bucket* const* slot = nullptr;  /**< Ячейка таблицы, пока не прочитана */
+            const Bucket*        cur  = nullptr;
+            uint64_t             hash = 0;
+            size_t               idx  = 0;
+        };
+        interleaveLookups<Lane>(keys.size(), group,
+            [&](Lane& l, size_t i) {
+                l.hash = hasher(keys[i]);
+                l.slot = &table[Hash::reduce(l.hash, table.size())];
+                l.idx  = i;
+                results[i] = View<Value>();
+                __builtin_prefetch(l.slot);
+                return true;
+            },
+            [&](Lane& l) {
+                if (l.slot) {
+                    l.cur  = *l.slot;
+                    l.slot = nullptr;
+                } else {
+                    const Bucket* b = l.cur;
+                    if (b->hash == l.hash && b->key == std::string_view(keys[l.idx])) {
+                        results[l.idx] = View<Value>(b->payload);
+                        return true;
+                    }
+                    l.cur = b->next;
+                }
+                if (!l.cur) return true;
+                prefetchObject(l.cur);
+                return false;
+            });
+    }
+
+    std::vector<Value> search(std::string_view key) const {
+        View<Value> v = lookup(key);
+        return {v.begin(), v.end()};
+    }
+
+    MemoryUsage memoryUsage() const {
+        MemoryUsage m;
+        m.buckets = (table.capacity() + target.capacity()) * sizeof(Bucket*);
+        auto account = [&](const Bucket* b) {
+            for (; b; b = b->next) {
+                m.nodes   += sizeof(Bucket);
+                m.payload += b->payload.capacity() * sizeof(Value);
+                m.keys    += stringHeapBytes(b->key);
+            }
+        };
+        for (const auto* tab : {&table, &target})
+            for (const Bucket* b : *tab) account(b);
+        account(freeBuckets);
+        m.arena = arena.reservedBytes();
+        for (const auto& a : bulkArenas) m.arena += a->reservedBytes();
+        return m;
+    }
+
+    /**
+     * @brief Различных ключей, при вставке попавших в уже непустую корзину.
+     *
+     * Повторные вставки существующего ключа коллизиями не считаются.
+     * Счётчик накапливается за всю историю таблицы и при удалении
+     * не уменьшается; текущее распределение даёт stats().
+     */
+    size_t collisionCount() const { return collisions; }
+
+    /**
+     * @brief Текущее распределение ключей по цепочкам.
+     *
+     * Во время перехеширования учитываются ещё не перенесённые корзины
+     * старой таблицы и все корзины новой.
+     */
+    HashStats stats() const {
+        std::vector<size_t> chains(1, 0);
+        auto account = [&](const Bucket* b) {
+            size_t len = 0;
+            for (; b; b = b->next) ++len;
+            if (len >= chains.size()) chains.resize(len + 1, 0);
+            ++chains[len];
+        };
+        for (size_t i = rehashing() ? migrated : 0; i < table.size(); ++i) account(table[i]);
+        for (const Bucket* b : target) account(b);
+        return HashStats::fromChains(std::move(chains));
+    }
+};
+
+/** @brief Хеш-таблица с прежним полиномиальным хешем. */
+using HashTable   = BasicHashTable<PolyHash>;
+/** @brief Хеш-таблица с wyhash. */
+using WyHashTable = BasicHashTable<WyHash>;
+/** @brief Хеш-таблица с wyhash над PassengerStore: в корзинах номера строк. */
+using RowHashTable = BasicHashTable<WyHash, RowId>;
+
+/**
+ * @class FlatHashTable
+ * @brief Хеш-таблица с открытой адресацией (Robin Hood hashing).
+ *
+ * Вместо цепочек из отдельно выделенных узлов все данные лежат
+ * в непрерывных массивах: слоты с метаданными (хеш, дистанция пробирования,
+ * номер записи), ключи и списки пассажиров. Строка ключа сравнивается
+ * только при совпадении хеша, поэтому пробирование почти не выходит
+ * за пределы массива слотов.
+ *
+ * Ёмкость — степень двойки: номер слота берётся маской младших битов хеша,
+ * отпечаток — из старших, поэтому политике нужны хорошо перемешанные биты.
+ *
+ * @tparam Hash Политика хеширования (по умолчанию WyHash).
+ */
+template<typename Hash = WyHash>
+class BasicFlatHashTable {
+    struct Slot {
+        uint32_t hash  = 0;   /**< Старшие 32 бита хеша ключа */
+        uint32_t dist  = 0;   /**< Дистанция от «домашнего» слота + 1 (0 — слот пуст) */
+        uint32_t entry = 0;   /**< Номер записи в keys/payloads */
+    };
+
+    std::vector<Slot>                          slots;
+    std::vector<std::string>                   keys;
+    std::vector<std::vector<const Passenger*>> payloads;
+    size_t                                     mask       = 0;
+    size_t                                     collisions = 0;
+    Hash                                       hasher;
+
+    static constexpr double kMaxLoad = 0.875;   /**< Предельный коэффициент заполнения */
+
+    // Robin Hood: «бедный» элемент (дальше от дома) вытесняет «богатого»
+    void place(Slot cur, size_t i) {
+        for (;; i = (i + 1) & mask, ++cur.dist) {
+            Slot& s = slots[i];
+            if (s.dist == 0) { s = cur; return; }
+            if (s.dist < cur.dist) std::swap(s, cur);
+        }
+    }
+
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        mask = slots.size() - 1;
+        for (const Slot& s : old) {
+            if (s.dist == 0) continue;
+            uint64_t h = hasher(keys[s.entry]);
+            place(Slot{s.hash, 1, s.entry}, h & mask);
+        }
+    }
+public:
+    explicit BasicFlatHashTable(size_t nBuckets, Hash hash = Hash{}) : hasher(hash) {
+        size_t cap = 8;
+        while (cap < nBuckets) cap <<= 1;
+        slots.resize(cap);
+        mask = cap - 1;
+    }
+
+    void insert(const Passenger& p) {
+        uint64_t h  = hasher(p.fullName);
+        uint32_t fp = static_cast<uint32_t>(h >> 32);
+        size_t   i  = h & mask;
+        uint32_t dist = 1;
+        for (;; i = (i + 1) & mask, ++dist) {
+            const Slot& s = slots[i];
+            if (s.dist < dist) break;           // ключа в таблице нет
+            if (s.hash == fp && keys[s.entry] == p.fullName) {
+                payloads[s.entry].push_back(&p);
+                return;
+            }
+        }
+        if (keys.size() + 1 > slots.size() * kMaxLoad) {
+            grow();
+            i    = h & mask;
+            dist = 1;
+            while (slots[i].dist >= dist) { i = (i + 1) & mask; ++dist; }
+        }
+        // домашний слот занят => коллизия
+        if (dist > 1) collisions++;
+        Slot cur{fp, dist, static_cast<uint32_t>(keys.size())};
+        keys.push_back(p.fullName);
+        payloads.push_back({&p});
+        place(cur, i);
+    }
+
+    PayloadView lookup(std::string_view key) const {
+        uint64_t h  = hasher(key);
+        uint32_t fp = static_cast<uint32_t>(h >> 32);
+        size_t   i  = h & mask;
+        for (uint32_t dist = 1;; i = (i + 1) & mask, ++dist) {
+            const Slot& s = slots[i];
+            if (s.dist < dist) return {};
+            if (s.hash == fp && keys[s.entry] == key) return PayloadView(payloads[s.entry]);
+        }
+    }
+
+    std::vector<const Passenger*> search(std::string_view key) const {
+        PayloadView v = lookup(key);
+        return {v.begin(), v.end()};
+    }
+
+    MemoryUsage memoryUsage() const {
+        MemoryUsage m;
+        m.buckets = slots.capacity() * sizeof(Slot);
+        m.nodes   = keys.capacity() * sizeof(std::string)
+                  + payloads.capacity() * sizeof(std::vector<const Passenger*>);
+        for (const auto& k : keys) m.keys += stringHeapBytes(k);
+        for (const auto& v : payloads) m.payload += v.capacity() * sizeof(const Passenger*);
+        return m;
+    }
+
+    /** @brief Ключей, вставленных не в свой домашний слот. */
+    size_t collisionCount() const { return collisions; }
+
+    /**
+     * @brief Распределение длин пробирования.
+     *
+     * Успешный поиск ключа стоит его дистанции; неуспешный поиск из слота i
+     * идёт до первого слота, чья дистанция меньше текущей, и усредняется
+     * по всем домашним слотам.
+     */
+    HashStats stats() const {
+        HashStats s;
+        s.keys    = keys.size();
+        s.buckets = slots.size();
+        s.histogram.assign(1, 0);
+        double hitProbes = 0, missProbes = 0;
+        for (const Slot& sl : slots) {
+            if (sl.dist == 0) { ++s.emptyBuckets; continue; }
+            if (sl.dist >= s.histogram.size()) s.histogram.resize(sl.dist + 1, 0);
+            ++s.histogram[sl.dist];
+            s.collisions += sl.dist > 1;
+            s.maxChain    = std::max<size_t>(s.maxChain, sl.dist);
+            hitProbes    += sl.dist;
+        }
+        for (size_t home = 0; home < slots.size(); ++home) {
+            uint32_t dist = 1;
+            for (size_t i = home; slots[i].dist >= dist; i = (i + 1) & mask) ++dist;
+            missProbes += dist;
+        }
+        s.loadFactor    = double(s.keys) / s.buckets;
+        s.avgProbesHit  = s.keys ? hitProbes / s.keys : 0;
+        s.avgProbesMiss = missProbes / s.buckets;
+        return s;
+    }
+};
+
+/** @brief Хеш-таблица с открытой адресацией и wyhash. */
+using FlatHashTable = BasicFlatHashTable<>;
+
+/**
+ * @class EpochDomain
+ * @brief Эпохи для освобождения памяти, которую могут читать потоки без блокировок.
+ *
+ * Читатель на время обхода структуры держит Guard: он объявляет в своём
+ * слоте текущее значение глобальных часов. Снятый из структуры объект
+ * получает эпоху retireEpoch() и может быть освобождён, как только все
+ * объявленные эпохи больше неё: любой читатель, вошедший позже, уже не
+ * найдёт объект по ссылкам структуры. Домен один на процесс, слот потока
+ * занимается при первом входе и освобождается при завершении потока.
+ */
+class EpochDomain {
+public:
+    static constexpr size_t kMaxThreads = 256;  /**< Наибольшее число читающих потоков */
+
+    static EpochDomain& global() {
+        static EpochDomain d;
+        return d;
+    }
+
+    /** @brief Критическая секция читателя; вложенные секции допускаются. */
+    class Guard {
+    public:
+        Guard() { global().enter(); }
+        ~Guard() { global().leave(); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    /** @brief Эпоха снятия объекта; сдвигает часы вперёд. */
+    uint64_t retireEpoch() { return clock.fetch_add(1); }
+
+    /** @brief Наименьшая эпоха среди читателей внутри Guard (UINT64_MAX, если их нет). */
+    uint64_t minActive() const {
+        uint64_t m = UINT64_MAX;
+        for (const Slot& s : slots) {
+            uint64_t e = s.epoch.load();
+            if (e && e < m) m = e;
+        }
+        return m;
+    }
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};     // 0 — поток вне критической секции
+        std::atomic<bool>     used{false};
+    };
+    // Слот текущего потока
+    struct Local {
+        size_t   slot  = SIZE_MAX;
+        unsigned depth = 0;
+        ~Local() { if (slot != SIZE_MAX) global().slots[slot].used.store(false); }
+    };
+
+    std::atomic<uint64_t> clock{1};
+    Slot                  slots[kMaxThreads];
+
+    static Local& local() {
+        thread_local Local l;
+        return l;
+    }
+    void enter() {
+        Local& l = local();
+        if (l.depth++) return;
+        if (l.slot == SIZE_MAX) {
+            for (size_t i = 0; i < kMaxThreads && l.slot == SIZE_MAX; ++i)
+                if (!slots[i].used.exchange(true)) l.slot = i;
+            if (l.slot == SIZE_MAX) {
+                l.depth = 0;
+                throw std::runtime_error("EpochDomain: слишком много потоков");
+            }
+        }
+        slots[l.slot].epoch.store(clock.load());
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    void leave() {
+        Local& l = local();
+        if (--l.depth == 0) slots[l.slot].epoch.store(0, std::memory_order_release);
+    }
+};
+
+/**
+ * @class ConcurrentHashTable
+ * @brief Хеш-таблица с цепочками для одновременного чтения и записи.
+ *
+ * Читатели не берут блокировок: они обходят цепочки по атомарным ссылкам
+ * внутри EpochDomain::Guard. Писатели сериализуются по полосам: корзина b
+ * принадлежит полосе b % kStripes, а так как число корзин — степень двойки
+ * не меньше kStripes, полоса ключа не зависит от размера таблицы.
+ *
+ * Узел после публикации не меняется, кроме ссылки next: добавление
+ * пассажира к существующему ключу публикует копию узла с дополненным
+ * списком (copy-on-write), удаление перешивает ссылку предшественника.
+ * Снятые узлы освобождаются, когда их уже не может видеть ни один читатель.
+ * Рост — под всеми полосами сразу: узлы копируются в новую таблицу, а старая
+ * таблица с узлами уходит на освобождение тем же путём.
+ *
+ * Представление списка пассажиров не может пережить Guard, поэтому вместо
+ * lookup() есть visit() с обработчиком и копирующий search().
+ *
+ * @tparam Hash Политика хеширования; номер корзины — младшие биты хеша.
+ */
+template<typename Hash = WyHash>
+class ConcurrentHashTable {
+    struct Node {
+        uint64_t                       hash;
+        std::string                    key;
+        std::vector<const Passenger*>  payload;
+        std::atomic<Node*>             next;
+
+        Node(uint64_t h, std::string_view k, std::vector<const Passenger*> pl, Node* n)
+            : hash(h), key(k), payload(std::move(pl)), next(n) {}
+    };
+    struct Table {
+        size_t                                mask;
+        std::unique_ptr<std::atomic<Node*>[]> buckets;
+
+        explicit Table(size_t n) : mask(n - 1), buckets(new std::atomic<Node*>[n]) {
+            for (size_t i = 0; i < n; ++i) buckets[i].store(nullptr, std::memory_order_relaxed);
+        }
+    };
+    // Снятый объект, ожидающий освобождения
+    struct Retired {
+        uint64_t epoch;
+        void*    ptr;
+        void   (*destroy)(void*);
+    };
+    struct alignas(64) Stripe {
+        std::mutex m;
+    };
+
+    static constexpr size_t kStripes = 64;
+
+    std::atomic<Table*>  table;
+    Stripe               stripes[kStripes];
+    std::atomic<size_t>  keyCount{0};
+    double               maxLoad;
+    std::mutex           retireMutex;
+    std::vector<Retired> retired;
+    size_t               reclaimAt = 64;    /**< Размер retired, при котором звать reclaim() */
+    Hash                 hasher;
+
+    std::mutex& stripeOf(uint64_t h) { return stripes[h & (kStripes - 1)].m; }
+
+    void retire(void* p, void (*destroy)(void*)) {
+        uint64_t e = EpochDomain::global().retireEpoch();
+        std::lock_guard<std::mutex> lk(retireMutex);
+        retired.push_back({e, p, destroy});
+        if (retired.size() >= reclaimAt) reclaim();
+    }
+
+    // Освобождает то, что уже не видит ни один читатель; под retireMutex
+    void reclaim() {
+        uint64_t safe = EpochDomain::global().minActive();
+        auto keep = std::partition(retired.begin(), retired.end(),
+                                   [&](const Retired& r) { return r.epoch >= safe; });
+        for (auto it = keep; it != retired.end(); ++it) it->destroy(it->ptr);
+        retired.erase(keep, retired.end());
+        // если читатели держат эпоху, не повторять проход на каждом снятии
+        reclaimAt = std::max<size_t>(64, retired.size() * 2);
+    }
+
+    // Ссылка на узел ключа в цепочке; вызывается под полосой ключа
+    std::atomic<Node*>* findLink(uint64_t h, std::string_view k) {
+        Table* t = table.load(std::memory_order_relaxed);
+        std::atomic<Node*>* link = &t->buckets[h & t->mask];
+        for (Node* cur; (cur = link->load(std::memory_order_relaxed)); link = &cur->next)
+            if (cur->hash == h && cur->key == k) return link;
+        return link;
+    }
+
+    // Заменяет узел *link копией со списком pl (пустой список — удаление узла)
+    void replace(std::atomic<Node*>* link, std::vector<const Passenger*> pl) {
+        Node* old  = link->load(std::memory_order_relaxed);
+        Node* next = old->next.load(std::memory_order_relaxed);
+        if (pl.empty()) {
+            link->store(next, std::memory_order_release);
+            keyCount.fetch_sub(1, std::memory_order_relaxed);
+        } else {
+            link->store(new Node(old->hash, old->key, std::move(pl), next),
+                        std::memory_order_release);
+        }
+        retire(old, [](void* q) { delete static_cast<Node*>(q); });
+    }
+
+    void growIfNeeded() {
+        {
+            EpochDomain::Guard g;   // таблицу может снять параллельный рост
+            if (keyCount.load(std::memory_order_relaxed) <= maxLoad * (table.load()->mask + 1))
+                return;
+        }
+        Table* old;
+        {
+            std::unique_lock<std::mutex> locks[kStripes];
+            for (size_t i = 0; i < kStripes; ++i)
+                locks[i] = std::unique_lock<std::mutex>(stripes[i].m);
+            old = table.load(std::memory_order_relaxed);
+            if (keyCount.load(std::memory_order_relaxed) <= maxLoad * (old->mask + 1)) return;
+            Table* t = new Table((old->mask + 1) * 2);
+            for (size_t b = 0; b <= old->mask; ++b) {
+                for (Node* cur = old->buckets[b].load(std::memory_order_relaxed); cur;
+                     cur = cur->next.load(std::memory_order_relaxed)) {
+                    std::atomic<Node*>& head = t->buckets[cur->hash & t->mask];
+                    head.store(new Node(cur->hash, cur->key, cur->payload,
+                                        head.load(std::memory_order_relaxed)),
+                               std::memory_order_relaxed);
+                }
+            }
+            table.store(t, std::memory_order_release);
+        }
+        // цепочки старой таблицы больше никто не меняет: она освобождается целиком
+        retire(old, [](void* q) { destroyTable(static_cast<Table*>(q)); });
+    }
+
+    static void destroyTable(Table* t) {
+        for (size_t b = 0; b <= t->mask; ++b) {
+            for (Node* cur = t->buckets[b].load(std::memory_order_relaxed); cur;) {
+                Node* next = cur->next.load(std::memory_order_relaxed);
+                delete cur;
+                cur = next;
+            }
+        }
+        delete t;
+    }
+public:
+    /**
+     * @param nBuckets      Начальное число корзин (округляется вверх до степени двойки,
+     *                      не меньше kStripes).
+     * @param hash          Объект хеш-функции.
+     * @param maxLoadFactor Допустимое число ключей на корзину до роста.
+     */
+    explicit ConcurrentHashTable(size_t nBuckets = kStripes, Hash hash = Hash{},
+                                 double maxLoadFactor = 1.0)
+        : maxLoad(maxLoadFactor), hasher(hash) {
+        size_t cap = kStripes;
+        while (cap < nBuckets) cap *= 2;
+        table.store(new Table(cap));
+    }
+
+    /** @pre Нет одновременных читателей и писателей. */
+    ~ConcurrentHashTable() {
+        destroyTable(table.load());
+        for (const Retired& r : retired) r.destroy(r.ptr);
+    }
+    ConcurrentHashTable(const ConcurrentHashTable&) = delete;
+    ConcurrentHashTable& operator=(const ConcurrentHashTable&) = delete;
+
+    void insert(const Passenger& p) {
+        uint64_t h = hasher(p.fullName);
+        {
+            std::lock_guard<std::mutex> lk(stripeOf(h));
+            std::atomic<Node*>* link = findLink(h, p.fullName);
+            if (Node* cur = link->load(std::memory_order_relaxed)) {
+                std::vector<const Passenger*> pl;
+                pl.reserve(cur->payload.size() + 1);
+                pl.assign(cur->payload.begin(), cur->payload.end());
+                pl.push_back(&p);
+                replace(link, std::move(pl));
+                return;
+            }
+            Table* t = table.load(std::memory_order_relaxed);
+            std::atomic<Node*>& head = t->buckets[h & t->mask];
+            head.store(new Node(h, p.fullName, {&p}, head.load(std::memory_order_relaxed)),
+                       std::memory_order_release);
+            keyCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        growIfNeeded();
+    }
+
+    /** @return size_t Сколько пассажиров удалено вместе с ключом. */
+    size_t erase(std::string_view key) {
+        uint64_t h = hasher(key);
+        std::lock_guard<std::mutex> lk(stripeOf(h));
+        std::atomic<Node*>* link = findLink(h, key);
+        Node* cur = link->load(std::memory_order_relaxed);
+        if (!cur) return 0;
+        size_t removed = cur->payload.size();
+        replace(link, {});
+        return removed;
+    }
+
+    /** @return true, если пассажир p с ключом key был в таблице. */
+    bool erase(std::string_view key, const Passenger* p) {
+        uint64_t h = hasher(key);
+        std::lock_guard<std::mutex> lk(stripeOf(h));
+        std::atomic<Node*>* link = findLink(h, key);
+        Node* cur = link->load(std::memory_order_relaxed);
+        if (!cur) return false;
+        std::vector<const Passenger*> pl = cur->payload;
+        if (!removePassenger(pl, p)) return false;
+        replace(link, std::move(pl));
+        return true;
+    }
+
+    /**
+     * @brief Заменяет запись from с ключом key на to.
+     *
+     * При том же ключе читатели видят либо старый, либо новый список целиком.
+     *
+     * @return true, если from был в таблице.
+     */
+    bool update(std::string_view key, const Passenger* from, const Passenger& to) {
+        if (to.fullName != key) {
+            if (!erase(key, from)) return false;
+            insert(to);
+            return true;
+        }
+        uint64_t h = hasher(key);
+        std::lock_guard<std::mutex> lk(stripeOf(h));
+        std::atomic<Node*>* link = findLink(h, key);
+        Node* cur = link->load(std::memory_order_relaxed);
+        if (!cur) return false;
+        std::vector<const Passenger*> pl = cur->payload;
+        if (!replacePassenger(pl, from, &to)) return false;
+        replace(link, std::move(pl));
+        return true;
+    }
+
+    /**
+     * @brief Вызывает f(PayloadView) для пассажиров с ключом key, не беря блокировок.
+     *
+     * Представление действительно только внутри f.
+     *
+     * @return true, если ключ найден.
+     */
+    template<typename F>
+    bool visit(std::string_view key, F&& f) const {
+        uint64_t h = hasher(key);
+        EpochDomain::Guard g;
+        const Table* t = table.load(std::memory_order_acquire);
+        for (const Node* cur = t->buckets[h & t->mask].load(std::memory_order_acquire); cur;
+             cur = cur->next.load(std::memory_order_acquire)) {
+            if (cur->hash == h && cur->key == key) {
+                f(PayloadView(cur->payload));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<const Passenger*> search(std::string_view key) const {
+        std::vector<const Passenger*> out;
+        visit(key, [&](PayloadView v) { out.assign(v.begin(), v.end()); });
+        return out;
+    }
+
+    /** @brief Число различных ключей. */
+    size_t size() const { return keyCount.load(std::memory_order_relaxed); }
+
+    /** @brief Память таблицы; узлы, ждущие освобождения, не учитываются. @pre Нет писателей. */
+    MemoryUsage memoryUsage() const {
+        MemoryUsage m;
+        const Table* t = table.load();
+        m.buckets = (t->mask + 1) * sizeof(std::atomic<Node*>);
+        for (size_t b = 0; b <= t->mask; ++b) {
+            for (const Node* cur = t->buckets[b].load(); cur; cur = cur->next.load()) {
+                m.nodes   += sizeof(Node);
+                m.payload += cur->payload.capacity() * sizeof(const Passenger*);
+                m.keys    += stringHeapBytes(cur->key);
+            }
+        }
+        return m;
+    }
+};
+
+/**
+ * @brief Ранги узлов неявного дерева Эйтцингера из m узлов.
+ *
+ * Обход in-order (с явным стеком) раздаёт узлам ранги по возрастанию:
+ * rankOf[k] — номер ключа, который должен стоять в позиции BFS k (1..m).
+ */
+static std::vector<uint32_t> eytzingerRanks(size_t m) {
+    std::vector<uint32_t> rankOf(m + 1);
+    std::vector<size_t>   stack;
+    uint32_t rank = 0;
+    size_t   k    = 1;
+    while (k <= m || !stack.empty()) {
+        for (; k <= m; k *= 2) stack.push_back(k);
+        k = stack.back();
+        stack.pop_back();
+        rankOf[k] = rank++;
+        k = 2 * k + 1;
+    }
+    return rankOf;
+}
+
+/**
+ * @brief Спуск по дереву Эйтцингера tree[1..m] без ветвлений.
+ *
+ * Заранее запрашивается линия с внуками текущего узла: tree[4k..4k+3]
+ * при 16-байтовых префиксах и выравнивании на 64 — ровно одна кеш-линия.
+ * Из четырёх линий правнуков (tree[16k..16k+15]) одна пригодилась бы
+ * лишь в четверти спусков, а запрос всех четырёх дороже, чем экономит.
+ *
+ * @return size_t Позиция BFS первого префикса >= q; 0, если такого нет.
+ */
+inline size_t eytzingerLowerBound(const KeyPrefix* tree, size_t m, const KeyPrefix& q) {
+    size_t k = 1;
+    while (k <= m) {
+        __builtin_prefetch(tree + 4 * k);
+        k = 2 * k + (tree[k] < q);
+    }
+    // снимаем хвост «правых» шагов
+    return k >> __builtin_ffsll(static_cast<long long>(~k));
+}
+
+/**
+ * @class EytzingerIndex
+ * @brief Неизменяемый индекс: отсортированные ключи в порядке Эйтцингера (BFS).
+ *
+ * Узел k неявного дерева имеет потомков 2k и 2k+1, поэтому верхние уровни
+ * лежат в нескольких соседних кеш-линиях, а спуск не разыменовывает
+ * указателей. В дереве хранятся только 16-байтовые префиксы ключей
+ * (четыре узла на кеш-линию); спуск без ветвлений, а линия с внуками
+ * текущего узла (на 2 уровня ниже) запрашивается заранее.
+ * Полные ключи и пассажиры лежат в порядке сортировки в плоских массивах.
+ */
+class EytzingerIndex {
+    struct AlignedFree {
+        void operator()(KeyPrefix* p) const { ::operator delete[](p, std::align_val_t{64}); }
+    };
+
+    std::unique_ptr<KeyPrefix[], AlignedFree> tree;     /**< tree[1..m] в порядке BFS */
+    std::vector<uint32_t>         rankOf;    /**< Позиция BFS -> ранг ключа */
+    std::vector<std::string>      sortedKeys;/**< Ключи в порядке сортировки */
+    std::vector<uint32_t>         offsets;   /**< Ранг -> начало пассажиров, m + 1 элемент */
+    std::vector<const Passenger*> payload;   /**< Пассажиры всех ключей подряд */
+    size_t                        m = 0;     /**< Число различных ключей */
+public:
+    EytzingerIndex(const std::vector<Passenger>& data, ThreadPool& pool) {
+        std::vector<SortItem>  items = sortByKey(data, pool);
+        std::vector<KeyPrefix> prefixes;
+        payload.reserve(items.size());
+        for (size_t i = 0; i < items.size();) {
+            size_t j = i + 1;
+            while (j < items.size() && sameKey(items[i], items[j], data)) ++j;
+            prefixes.push_back(items[i].prefix);
+            sortedKeys.push_back(data[items[i].idx].fullName);
+            offsets.push_back(static_cast<uint32_t>(payload.size()));
+            for (size_t k = i; k < j; ++k) payload.push_back(&data[items[k].idx]);
+            i = j;
+        }
+        offsets.push_back(static_cast<uint32_t>(payload.size()));
+        m = prefixes.size();
+        tree.reset(static_cast<KeyPrefix*>(
+            ::operator new[]((m + 1) * sizeof(KeyPrefix), std::align_val_t{64})));
+        rankOf = eytzingerRanks(m);
+        for (size_t k = 1; k <= m; ++k) tree[k] = prefixes[rankOf[k]];
+    }
+
+    PayloadView lookup(std::string_view key) const {
+        const KeyPrefix q = KeyPrefix::of(key);
+        size_t k = eytzingerLowerBound(tree.get(), m, q);
+        if (k == 0) return {};
+        // общий префикс возможен только у ключей длиннее 16 байт
+        for (size_t r = rankOf[k]; r < m && KeyPrefix::of(sortedKeys[r]) == q; ++r) {
+            if (sortedKeys[r] == key)
+                return {payload.data() + offsets[r], payload.data() + offsets[r + 1]};
+        }
+        return {};
+    }
+
+    std::vector<const Passenger*> search(std::string_view key) const {
+        PayloadView v = lookup(key);
+        return {v.begin(), v.end()};
+    }
+
+    MemoryUsage memoryUsage() const {
+        MemoryUsage u;
+        u.buckets = (m + 1) * sizeof(KeyPrefix) + rankOf.capacity() * sizeof(uint32_t)
+                  + offsets.capacity() * sizeof(uint32_t);
+        u.nodes   = sortedKeys.capacity() * sizeof(std::string);
+        for (const auto& k : sortedKeys) u.keys += stringHeapBytes(k);
+        u.payload = payload.capacity() * sizeof(const Passenger*);
+        return u;
+    }
+};
+
+/**
+ * @class PerfectHashIndex
+ * @brief Неизменяемый индекс на минимальной совершенной хеш-функции (PTHash).
+ *
+ * Различные ключи раскладываются по корзинам с перекосом PTHash: 60 %
+ * ключей попадают в 30 % корзин. Корзины обрабатываются от больших
+ * к малым; для каждой подбирается пилот — наименьшее число k, при котором
+ * позиции rawPosition(h, k) всех её ключей свободны и различны.
+ * Таблица T чуть больше числа ключей m (kAlpha): последние одиночные
+ * корзины быстро находят свободное место, а позиции из [m, T) затем
+ * переназначаются (remap) на оставшиеся свободные позиции из [0, m).
+ * Так у каждого ключа ровно одна ячейка, коллизий нет.
+ *
+ * Пилоты упакованы минимальной шириной в битах. Поиск: хеш ключа, пилот
+ * его корзины (массив пилотов мал и обычно в кеше) и одна ячейка slots,
+ * где лежат префикс и длина ключа и отрезок его пассажиров. Для ключей
+ * до 16 байт этого достаточно, чтобы отвергнуть чужой ключ без второго
+ * обращения к памяти; более длинные сверяются по имени первого пассажира.
+ * Если у двух ключей совпали 64-битные хеши или пилот не найден
+ * за kMaxPilot попыток, построение повторяется с другим сидом.
+ * Слишком малое число корзин (bucketFactor около 1) оставляет крупные
+ * корзины на почти заполненную таблицу, и пилоты не находятся.
+ */
+class PerfectHashIndex {
+    struct Slot {
+        KeyPrefix prefix;       /**< Первые 16 байт ключа */
+        uint32_t  len   = 0;    /**< Длина ключа */
+        uint32_t  begin = 0;    /**< Пассажиры ключа: payload[begin, end) */
+        uint32_t  end   = 0;
+    };
+
+    static constexpr double   kAlpha    = 0.99;       /**< m / T */
+    static constexpr uint64_t kMaxPilot = 1u << 20;   /**< Предел поиска пилота */
+    static constexpr size_t   kMaxAttempts = 32;      /**< Предел числа сидов */
+    static constexpr uint64_t kSplit    = uint64_t(0.6 * 18446744073709551616.0);
+
+    WyHash                        hasher;
+    size_t                        m = 0;         /**< Число различных ключей */
+    size_t                        tableSize = 0; /**< T */
+    size_t                        buckets = 0;
+    size_t                        denseBuckets = 0;  /**< Корзины, куда идут 60 % ключей */
+    unsigned                      pilotBits = 1;
+    std::vector<uint64_t>         pilots;        /**< Пилоты по pilotBits бит */
+    std::vector<uint32_t>         remap;         /**< Позиция p >= m -> remap[p - m] */
+    std::vector<Slot>             slots;
+    std::vector<const Passenger*> payload;
+    size_t                        attempts = 0;  /**< Сколько сидов перепробовано */
+
+    static uint64_t mix(uint64_t k) { return (k + 1) * 0xbf58476d1ce4e5b9ull; }
+    size_t bucketOf(uint64_t h) const {
+        const uint64_t g = h * 0x9e3779b97f4a7c15ull;
+        return h < kSplit ? fastRange(g, denseBuckets)
+                          : denseBuckets + fastRange(g, buckets - denseBuckets);
+    }
+    // fastRange берёт старшие биты, поэтому h ^ mix(k) ещё перемешивается:
+    // иначе ключи с общими старшими битами хеша совпадали бы при любом пилоте
+    size_t rawPosition(uint64_t h, uint64_t pilot) const {
+        uint64_t x = h ^ mix(pilot);
+        x = (x ^ (x >> 32)) * 0x94d049bb133111ebull;
+        return fastRange(x ^ (x >> 29), tableSize);
+    }
+    uint64_t pilot(size_t b) const {
+        const size_t bit = b * pilotBits, w = bit >> 6, sh = bit & 63;
+        uint64_t v = pilots[w] >> sh;
+        if (sh + pilotBits > 64) v |= pilots[w + 1] << (64 - sh);
+        return pilotBits == 64 ? v : v & ((uint64_t(1) << pilotBits) - 1);
+    }
+    size_t position(uint64_t h) const {
+        size_t p = rawPosition(h, pilot(bucketOf(h)));
+        return p < m ? p : remap[p - m];
+    }
+
+    // Подбирает пилоты для хешей hashes; false — нужен другой сид
+    bool place(const std::vector<uint64_t>& hashes, std::vector<uint64_t>& found) {
+        std::vector<uint32_t> start(buckets + 1, 0), order(m);
+        for (uint64_t h : hashes) ++start[bucketOf(h) + 1];
+        for (size_t b = 0; b < buckets; ++b) start[b + 1] += start[b];
+        std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+        for (size_t i = 0; i < m; ++i) order[fill[bucketOf(hashes[i])]++] = static_cast<uint32_t>(i);
+        std::vector<uint32_t> byBucket(buckets);
+        for (size_t b = 0; b < buckets; ++b) byBucket[b] = static_cast<uint32_t>(b);
+        std::stable_sort(byBucket.begin(), byBucket.end(), [&](uint32_t a, uint32_t b) {
+            return start[a + 1] - start[a] > start[b + 1] - start[b];
+        });
+
+        std::vector<uint64_t> taken((tableSize + 63) / 64, 0);
+        auto isTaken = [&](size_t p) { return taken[p >> 6] >> (p & 63) & 1; };
+        std::vector<size_t> pos;
+        found.assign(buckets, 0);
+        for (uint32_t b : byBucket) {
+            const uint32_t* keys = order.data() + start[b];
+            const size_t size = start[b + 1] - start[b];
+            if (!size) break;   // дальше только пустые корзины
+            uint64_t k = 0;
+            for (;; ++k) {
+                if (k == kMaxPilot) return false;
+                pos.clear();
+                bool ok = true;
+                for (size_t j = 0; j < size && ok; ++j) {
+                    size_t p = rawPosition(hashes[keys[j]], k);
+                    ok = !isTaken(p) && std::find(pos.begin(), pos.end(), p) == pos.end();
+                    pos.push_back(p);
+                }
+                if (ok) break;
+            }
+            for (size_t p : pos) taken[p >> 6] |= uint64_t(1) << (p & 63);
+            found[b] = k;
+        }
+        remap.assign(tableSize - m, 0);
+        size_t freeSlot = 0;
+        for (size_t p = m; p < tableSize; ++p) {
+            if (!isTaken(p)) continue;
+            while (isTaken(freeSlot)) ++freeSlot;
+            remap[p - m] = static_cast<uint32_t>(freeSlot++);
+        }
+        return true;
+    }
+public:
+    /**
+     * @param data         Пассажиры; индекс хранит указатели на них.
+     * @param pool         Пул для сортировки записей по ключу.
+     * @param bucketFactor c: корзин c * m / log2(m); меньше — компактнее, но дольше поиск пилотов.
+     * @param seed         Начальный сид хеш-функции.
+     * @throws std::runtime_error Если за kMaxAttempts сидов пилоты не нашлись.
+     */
+    PerfectHashIndex(const std::vector<Passenger>& data, ThreadPool& pool,
+                     double bucketFactor = 5.0, uint64_t seed = 0) {
+        std::vector<SortItem> items = sortByKey(data, pool);
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        payload.reserve(items.size());
+        for (size_t i = 0; i < items.size();) {
+            size_t j = i + 1;
+            while (j < items.size() && sameKey(items[i], items[j], data)) ++j;
+            ranges.push_back({static_cast<uint32_t>(payload.size()),
+                              static_cast<uint32_t>(payload.size() + j - i)});
+            for (size_t k = i; k < j; ++k) payload.push_back(&data[items[k].idx]);
+            i = j;
+        }
+        m = ranges.size();
+        if (!m) return;
+        tableSize    = std::max<size_t>(m, static_cast<size_t>(std::ceil(m / kAlpha)));
+        buckets      = std::max<size_t>(2, static_cast<size_t>(
+                           std::ceil(bucketFactor * m / std::log2(double(m) + 1))));
+        denseBuckets = std::clamp<size_t>(static_cast<size_t>(0.3 * buckets), 1, buckets - 1);
+
+        std::vector<uint64_t> hashes(m), found;
+        for (;; ++seed) {
+            if (attempts++ == kMaxAttempts)
+                throw std::runtime_error("PerfectHashIndex: пилоты не найдены, увеличьте bucketFactor");
+            hasher = WyHash{seed};
+            for (size_t i = 0; i < m; ++i) hashes[i] = hasher(payload[ranges[i].first]->fullName);
+            std::vector<uint64_t> sorted(hashes);
+            std::sort(sorted.begin(), sorted.end());
+            if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) continue;
+            if (place(hashes, found)) break;
+        }
+
+        const uint64_t maxPilot = *std::max_element(found.begin(), found.end());
+        pilotBits = std::max(1, 64 - __builtin_clzll(maxPilot | 1));
+        pilots.assign((buckets * pilotBits + 63) / 64 + 1, 0);
+        for (size_t b = 0; b < buckets; ++b) {
+            const size_t bit = b * pilotBits, w = bit >> 6, sh = bit & 63;
+            pilots[w] |= found[b] << sh;
+            if (sh + pilotBits > 64) pilots[w + 1] |= found[b] >> (64 - sh);
+        }
+        slots.resize(m);
+        for (size_t i = 0; i < m; ++i)
+            slots[position(hashes[i])] = {KeyPrefix::of(payload[ranges[i].first]->fullName),
+                                          static_cast<uint32_t>(payload[ranges[i].first]->fullName.size()),
+                                          ranges[i].first, ranges[i].second};
+    }
+
+    PayloadView lookup(std::string_view key) const {
+        if (!m) return {};
+        const Slot& s = slots[position(hasher(key))];
+        if (s.len != key.size() || s.prefix != KeyPrefix::of(key)) return {};
+        if (key.size() > 16 && payload[s.begin]->fullName != key) return {};
+        return {payload.data() + s.begin, payload.data() + s.end};
+    }
+
+    std::vector<const Passenger*> search(std::string_view key) const {
+        PayloadView v = lookup(key);
+        return {v.begin(), v.end()};
+    }
+
+    /** @brief Число различных ключей. */
+    size_t size() const { return m; }
+    /** @brief Коллизий нет по построению: у каждого ключа своя ячейка. */
+    size_t collisionCount() const { return 0; }
+    /** @brief Сколько сидов понадобилось построению. */
+    size_t buildAttempts() const { return attempts; }
+    /** @brief Биты самой функции (пилоты и remap) на ключ, без ячеек и пассажиров. */
+    double bitsPerKey() const {
+        return m ? double(buckets * pilotBits + remap.size() * 32) / m : 0;
+    }
+
+    MemoryUsage memoryUsage() const {
+        MemoryUsage u;
+        u.buckets = pilots.capacity() * sizeof(uint64_t) + remap.capacity() * sizeof(uint32_t);
+        u.nodes   = slots.capacity() * sizeof(Slot);
+        u.payload = payload.capacity() * sizeof(const Passenger*);
+        return u;
+    }
+};
+
+/**
+ * @class Snapshot
+ * @brief Двоичный снимок пассажиров и двух неизменяемых индексов, читаемый через mmap.
+ *
+ * Файл — заголовок и выровненные на 64 байта секции; ссылки между секциями —
+ * смещения и номера, а не указатели, поэтому отображённый только для чтения
+ * файл пригоден для поиска сразу, без прохода десериализации. В снимке:
+ * столбцы PassengerStore, различные ключи в порядке сортировки со списками
+ * RowId, хеш-индекс с линейным пробированием (wyhash) и дерево префиксов
+ * в порядке Эйтцингера. Числа записаны в порядке байт машины; снимок
+ * с другим порядком байт или другой версией формата отвергается.
+ *
+ * Открытие проверяет только заголовок и границы секций и не читает
+ * их содержимое; ссылки внутри секций проверяет verify().
+ */
+class Snapshot {
+public:
+    static constexpr uint32_t kVersion = 1;
+private:
+    enum Section {
+        NameChars, NameOffsets, CabinNumbers, CabinTypes, Ports,
+        KeyChars, KeyOffsets, RowOffsets, RowIds, HashSlots, TreePrefixes, TreeRanks,
+        SectionCount
+    };
+    struct Extent {
+        uint64_t offset;
+        uint64_t size;
+    };
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t byteOrder;         /**< kByteOrder в порядке байт записавшей машины */
+        uint64_t seed;              /**< Зерно wyhash хеш-индекса */
+        uint64_t rows;              /**< Число строк */
+        uint64_t keys;              /**< Число различных ключей */
+        uint64_t slots;             /**< Ёмкость хеш-индекса, степень двойки */
+        Extent   sections[SectionCount];
+    };
+    /** @brief Ячейка хеш-индекса; rank1 == 0 — пусто. */
+    struct Slot {
+        uint32_t tag;               /**< Старшие 32 бита хеша */
+        uint32_t rank1;             /**< Ранг ключа + 1 */
+    };
+
+    static constexpr char     kMagic[8]  = {'P', 'S', 'N', 'A', 'P', 'S', 'H', 'T'};
+    static constexpr uint32_t kByteOrder = 0x01020304;
+    static constexpr size_t   kAlign     = 64;
+
+    const unsigned char* base  = nullptr;
+    size_t               bytes = 0;
+    const Header*        hdr   = nullptr;
+#if !(defined(__unix__) || defined(__APPLE__))
+    std::vector<unsigned char> buffer;      // без mmap файл читается целиком
+#endif
+
+    template<typename T>
+    const T* section(Section s) const {
+        return reinterpret_cast<const T*>(base + hdr->sections[s].offset);
+    }
+
+    std::string_view keyAt(size_t r) const {
+        const uint32_t* off = section<uint32_t>(KeyOffsets);
+        return {section<char>(KeyChars) + off[r], off[r + 1] - off[r]};
+    }
+    View<RowId> rowsOf(size_t r) const {
+        const uint32_t* off = section<uint32_t>(RowOffsets);
+        const RowId*    ids = section<RowId>(RowIds);
+        return {ids + off[r], ids + off[r + 1]};
+    }
+
+    [[noreturn]] static void fail(const char* what) {
+        throw std::runtime_error(std::string("снимок повреждён: ") + what);
+    }
+
+    // Заголовок, размеры и выравнивание секций; содержимое секций не читается
+    void checkLayout() const {
+        if (bytes < sizeof(Header)) fail("файл короче заголовка");
+        if (std::memcmp(hdr->magic, kMagic, sizeof(kMagic)) != 0) fail("неверная сигнатура");
+        if (hdr->version != kVersion) fail("неподдерживаемая версия");
+        if (hdr->byteOrder != kByteOrder) fail("другой порядок байт");
+        const uint64_t n = hdr->rows, m = hdr->keys;
+        // каждая строка, ключ и ячейка занимают в файле хотя бы байт: размеры ниже не переполнятся
+        if (n > bytes || m > bytes || hdr->slots > bytes) fail("число строк или ключей");
+        if (hdr->slots & (hdr->slots - 1) || hdr->slots <= m) fail("ёмкость хеш-индекса");
+        const uint64_t expect[SectionCount] = {
+            UINT64_MAX, (n + 1) * 4, n * 4, n, n * PassengerStore::kPortLen,
+            UINT64_MAX, (m + 1) * 4, (m + 1) * 4, n * 4, hdr->slots * sizeof(Slot),
+            (m + 1) * sizeof(KeyPrefix), (m + 1) * 4
+        };
+        for (int s = 0; s < SectionCount; ++s) {
+            const Extent& e = hdr->sections[s];
+            if (e.offset % kAlign || e.offset > bytes || e.size > bytes - e.offset)
+                fail("секция за пределами файла");
+            if (expect[s] != UINT64_MAX && e.size != expect[s]) fail("размер секции");
+        }
+    }
+public:
+    /**
+     * @brief Проверяет все ссылки внутри секций.
+     *
+     * После проверки ни один поиск и ни одно обращение к строке с номером
+     * из RowIds не читает за пределами секций, а пробирование хеш-индекса
+     * всегда упирается в пустую ячейку. Стоит одного последовательного
+     * прохода по файлу, поэтому открытие его не вызывает; снимок из
+     * недоверенного источника нужно проверить до первого поиска.
+     *
+     * @throws std::runtime_error Если снимок повреждён.
+     */
+    void verify() const {
+        const uint64_t n = hdr->rows, m = hdr->keys;
+        // смещения не убывают и не выходят за свою секцию
+        auto monotonic = [&](Section s, uint64_t count, uint64_t limit) {
+            const uint32_t* off = section<uint32_t>(s);
+            for (uint64_t i = 0; i < count; ++i)
+                if (off[i] > off[i + 1]) return false;
+            return off[0] == 0 && off[count] <= limit;
+        };
+        if (!monotonic(NameOffsets, n, hdr->sections[NameChars].size)
+            || !monotonic(KeyOffsets, m, hdr->sections[KeyChars].size)
+            || !monotonic(RowOffsets, m, n) || section<uint32_t>(RowOffsets)[m] != n)
+            fail("смещения");
+        const RowId* ids = section<RowId>(RowIds);
+        if (!std::all_of(ids, ids + n, [n](RowId r) { return r < n; })) fail("номер строки");
+        const uint8_t* types = section<uint8_t>(CabinTypes);
+        if (!std::all_of(types, types + n, [](uint8_t t) { return t <= uint8_t(CabinType::Third); }))
+            fail("тип каюты");
+        const Slot* tab = section<Slot>(HashSlots);
+        size_t empty = 0;
+        for (uint64_t i = 0; i < hdr->slots; ++i) {
+            if (tab[i].rank1 > m) fail("ячейка хеш-индекса");
+            empty += tab[i].rank1 == 0;
+        }
+        if (empty == 0) fail("в хеш-индексе нет пустых ячеек");
+        const uint32_t* ranks = section<uint32_t>(TreeRanks);
+        if (!std::all_of(ranks + 1, ranks + m + 1, [m](uint32_t r) { return r < m; }))
+            fail("ранг дерева");
+    }
+
+    /**
+     * @brief Записывает снимок store вместе с индексами.
+     *
+     * @throws std::runtime_error При ошибке записи.
+     */
+    static void write(const std::string& path, const PassengerStore& store, uint64_t seed = 0) {
+        const size_t n = store.size();
+        std::vector<RowId> order(n);
+        for (size_t r = 0; r < n; ++r) order[r] = static_cast<RowId>(r);
+        std::stable_sort(order.begin(), order.end(),
+                         [&](RowId a, RowId b) { return store.name(a) < store.name(b); });
+
+        std::vector<char>      keyChars;
+        std::vector<uint32_t>  keyOffsets{0}, rowOffsets{0};
+        std::vector<KeyPrefix> prefixes;
+        for (size_t i = 0; i < n;) {
+            std::string_view k = store.name(order[i]);
+            size_t j = i + 1;
+            while (j < n && store.name(order[j]) == k) ++j;
+            keyChars.insert(keyChars.end(), k.begin(), k.end());
+            keyOffsets.push_back(static_cast<uint32_t>(keyChars.size()));
+            rowOffsets.push_back(static_cast<uint32_t>(j));
+            prefixes.push_back(KeyPrefix::of(k));
+            i = j;
+        }
+        const size_t m = prefixes.size();
+
+        size_t slots = 8;
+        while (slots < 2 * m) slots *= 2;
+        std::vector<Slot> table(slots, Slot{0, 0});
+        WyHash hasher{seed};
+        for (size_t r = 0; r < m; ++r) {
+            std::string_view k(keyChars.data() + keyOffsets[r], keyOffsets[r + 1] - keyOffsets[r]);
+            uint64_t h = hasher(k);
+            size_t i = h & (slots - 1);
+            while (table[i].rank1) i = (i + 1) & (slots - 1);
+            table[i] = {static_cast<uint32_t>(h >> 32), static_cast<uint32_t>(r + 1)};
+        }
+        std::vector<uint32_t>  ranks = eytzingerRanks(m);
+        std::vector<KeyPrefix> tree(m + 1);
+        for (size_t k = 1; k <= m; ++k) tree[k] = prefixes[ranks[k]];
+
+        std::vector<char>     names;
+        std::vector<uint32_t> nameOffsets{0};
+        std::vector<int32_t>  cabins(n);
+        std::vector<uint8_t>  types(n);
+        std::vector<char>     ports(n * PassengerStore::kPortLen, '\0');
+        for (size_t r = 0; r < n; ++r) {
+            RowId id = static_cast<RowId>(r);
+            std::string_view nm = store.name(id), port = store.destinationPort(id);
+            names.insert(names.end(), nm.begin(), nm.end());
+            nameOffsets.push_back(static_cast<uint32_t>(names.size()));
+            cabins[r] = store.cabinNumber(id);
+            types[r]  = static_cast<uint8_t>(store.cabinType(id));
+            std::memcpy(&ports[r * PassengerStore::kPortLen], port.data(), port.size());
+        }
+
+        Header h{};
+        std::memcpy(h.magic, kMagic, sizeof(kMagic));
+        h.version   = kVersion;
+        h.byteOrder = kByteOrder;
+        h.seed      = seed;
+        h.rows      = n;
+        h.keys      = m;
+        h.slots     = slots;
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) throw std::runtime_error("не удалось создать " + path);
+        static const char zeros[kAlign] = {};
+        uint64_t pos = 0;
+        auto put = [&](const void* p, size_t len) {
+            out.write(static_cast<const char*>(p), static_cast<std::streamsize>(len));
+            pos += len;
+        };
+        auto pad = [&] { put(zeros, (kAlign - pos % kAlign) % kAlign); };
+        put(&h, sizeof(h));
+        auto sectionOut = [&](Section s, const void* p, size_t len) {
+            pad();
+            h.sections[s] = {pos, len};
+            put(p, len);
+        };
+        sectionOut(NameChars,    names.data(),      names.size());
+        sectionOut(NameOffsets,  nameOffsets.data(), nameOffsets.size() * 4);
+        sectionOut(CabinNumbers, cabins.data(),     n * 4);
+        sectionOut(CabinTypes,   types.data(),      n);
+        sectionOut(Ports,        ports.data(),      ports.size());
+        sectionOut(KeyChars,     keyChars.data(),   keyChars.size());
+        sectionOut(KeyOffsets,   keyOffsets.data(), keyOffsets.size() * 4);
+        sectionOut(RowOffsets,   rowOffsets.data(), rowOffsets.size() * 4);
+        sectionOut(RowIds,       order.data(),      n * 4);
+        sectionOut(HashSlots,    table.data(),      slots * sizeof(Slot));
+        sectionOut(TreePrefixes, tree.data(),       (m + 1) * sizeof(KeyPrefix));
+        sectionOut(TreeRanks,    ranks.data(),      (m + 1) * 4);
+        pad();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.close();
+        if (!out) throw std::runtime_error("ошибка записи " + path);
+    }
+
+    /**
+     * @brief Отображает снимок в память только для чтения и проверяет заголовок.
+     *
+     * @throws std::runtime_error Если файл не открывается, его заголовок
+     *         или границы секций повреждены.
+     */
+    explicit Snapshot(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("не удалось открыть " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("пустой файл " + path);
+        }
+        bytes = static_cast<size_t>(st.st_size);
+        void* p = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("mmap не удался для " + path);
+        base = static_cast<const unsigned char*>(p);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("не удалось открыть " + path);
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        base  = buffer.data();
+        bytes = buffer.size();
+#endif
+        hdr = reinterpret_cast<const Header*>(base);
+        try {
+            checkLayout();
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+    ~Snapshot() { unmap(); }
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    size_t size() const { return hdr->rows; }
+    size_t keyCount() const { return hdr->keys; }
+    size_t fileBytes() const { return bytes; }
+
+    std::string_view name(RowId r) const {
+        const uint32_t* off = section<uint32_t>(NameOffsets);
+        return {section<char>(NameChars) + off[r], off[r + 1] - off[r]};
+    }
+    int       cabinNumber(RowId r) const { return section<int32_t>(CabinNumbers)[r]; }
+    CabinType cabinType(RowId r) const   { return section<CabinType>(CabinTypes)[r]; }
+    std::string_view destinationPort(RowId r) const {
+        const char* p = section<char>(Ports) + size_t(r) * PassengerStore::kPortLen;
+        const void* end = std::memchr(p, '\0', PassengerStore::kPortLen);
+        return {p, end ? static_cast<size_t>(static_cast<const char*>(end) - p)
+                       : PassengerStore::kPortLen};
+    }
+
+    /** @brief Поиск через хеш-индекс; строки — в порядке добавления в PassengerStore. */
+    View<RowId> lookup(std::string_view key) const {
+        const uint64_t h    = WyHash{hdr->seed}(key);
+        const uint32_t tag  = static_cast<uint32_t>(h >> 32);
+        const size_t   mask = hdr->slots - 1;
+        const Slot*    tab  = section<Slot>(HashSlots);
+        for (size_t i = h & mask; tab[i].rank1; i = (i + 1) & mask)
+            if (tab[i].tag == tag && keyAt(tab[i].rank1 - 1) == key) return rowsOf(tab[i].rank1 - 1);
+        return {};
+    }
+
+    /** @brief Тот же поиск через дерево Эйтцингера. */
+    View<RowId> lookupTree(std::string_view key) const {
+        const KeyPrefix q = KeyPrefix::of(key);
+        const size_t    m = hdr->keys;
+        size_t k = eytzingerLowerBound(section<KeyPrefix>(TreePrefixes), m, q);
+        if (k == 0) return {};
+        for (size_t r = section<uint32_t>(TreeRanks)[k]; r < m && KeyPrefix::of(keyAt(r)) == q; ++r)
+            if (keyAt(r) == key) return rowsOf(r);
+        return {};
+    }
+private:
+    void unmap() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (base) ::munmap(const_cast<unsigned char*>(base), bytes);
+#endif
+        base = nullptr;
+    }
+};
+
+/**
+ * @class BlockedBloomFilter
+ * @brief Блочный фильтр Блума: все биты ключа лежат в одном 32-байтовом блоке.
+ *
+ * Схема split block (как в Parquet и Impala): блок — восемь 32-битных
+ * слов, ключ ставит по одному биту в каждое слово; номер бита —
+ * старшие 5 бит произведения младшей половины хеша на свою нечётную
+ * «соль». Старшая половина хеша выбирает блок, так что проверка —
+ * один промах кеша и восемь независимых операций, которые компилятор
+ * сводит к векторным. Удаление не поддерживается: после erase в индексе
+ * фильтр лишь чаще отвечает «возможно», ложных отрицаний не бывает.
+ */
+class BlockedBloomFilter {
+    struct alignas(32) Block {
+        uint32_t w[8];
+    };
+    static constexpr uint32_t kSalt[8] = {
+        0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+        0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+    };
+
+    std::vector<Block> blocks;
+    WyHash             hasher;
+    size_t             added = 0;
+
+    const Block& blockOf(uint64_t h) const { return blocks[fastRange(h, blocks.size())]; }
+    static uint32_t bit(uint32_t h, int i) { return 1u << ((h * kSalt[i]) >> 27); }
+public:
+    /**
+     * @param expectedKeys Ожидаемое число ключей.
+     * @param bitsPerKey   Бит фильтра на ключ; 12 дают около 0.5% ложных срабатываний.
+     * @param hash         Хеш-функция (сид).
+     */
+    explicit BlockedBloomFilter(size_t expectedKeys, double bitsPerKey = 12, WyHash hash = {})
+        : blocks(std::max<size_t>(1, static_cast<size_t>(
+              std::ceil(expectedKeys * bitsPerKey / (8 * sizeof(Block)))))),
+          hasher(hash)
+    {
+        std::memset(blocks.data(), 0, blocks.size() * sizeof(Block));
+    }
+
+    void add(std::string_view key) {
+        const uint64_t h = hasher(key);
+        Block& b = blocks[fastRange(h, blocks.size())];
+        for (int i = 0; i < 8; ++i) b.w[i] |= bit(static_cast<uint32_t>(h), i);
+        ++added;
+    }
+
+    /** @return false — ключа точно нет; true — ключ, возможно, есть. */
+    bool mayContain(std::string_view key) const {
+        const uint64_t h = hasher(key);
+        const Block& b = blockOf(h);
+        uint32_t missing = 0;
+        for (int i = 0; i < 8; ++i) missing |= bit(static_cast<uint32_t>(h), i) & ~b.w[i];
+        return missing == 0;
+    }
+
+    /** @brief Сколько раз вызывался add(); повторные ключи тоже считаются. */
+    size_t size() const { return added; }
+
+    MemoryUsage memoryUsage() const {
+        MemoryUsage m;
+        m.buckets = blocks.capacity() * sizeof(Block);
+        return m;
+    }
+};
+
+/**
+ * @class FilteredIndex
+ * @brief Индекс, перед которым стоит BlockedBloomFilter: промах отсекается без спуска по индексу.
+ *
+ * Обёртка не владеет индексом. Ключи, вставленные в индекс после
+ * построения, нужно передать в add(); удаления фильтр не требуют.
+ *
+ * @tparam Index Индекс с методом lookup(std::string_view) const.
+ */
+template<typename Index>
+class FilteredIndex {
+    const Index&       index;
+    BlockedBloomFilter filter;
+public:
+    using Result = decltype(std::declval<const Index&>().lookup(std::string_view{}));
+
+    /** @brief Строит фильтр по ключам data; размер — по числу различных ключей. */
+    FilteredIndex(const Index& index, const std::vector<Passenger>& data,
+                  double bitsPerKey = 12, WyHash hash = {})
+        : index(index), filter(distinctKeys(data), bitsPerKey, hash)
+    {
+        for (const auto& p : data) filter.add(p.fullName);
+    }
+
+    static size_t distinctKeys(const std::vector<Passenger>& data) {
+        std::vector<std::string_view> keys;
+        keys.reserve(data.size());
+        for (const auto& p : data) keys.push_back(p.fullName);
+        std::sort(keys.begin(), keys.end());
+        return static_cast<size_t>(std::unique(keys.begin(), keys.end()) - keys.begin());
+    }
+
+    void add(std::string_view key) { filter.add(key); }
+
+    Result lookup(std::string_view key) const {
+        if (!filter.mayContain(key)) return Result{};
+        return index.lookup(key);
+    }
+
+    const BlockedBloomFilter& bloom() const { return filter; }
+};
+
+/**
+ * @struct CacheStats
+ * @brief Счётчики попаданий CachedIndex.
+ */
+struct CacheStats {
+    size_t hits   = 0;      /**< Ответов из кеша */
+    size_t misses = 0;      /**< Обращений к индексу */
+
+    double hitRate() const { return hits + misses ? double(hits) / (hits + misses) : 0.0; }
+};
+
+/**
+ * @class CachedIndex
+ * @brief Ограниченный кеш результатов lookup() поверх любого индекса с вытеснением CLOCK.
+ *
+ * Ключи делятся на kShards сегментов по старшим битам хеша, у каждого
+ * сегмента свой мьютекс, кольцо записей и словарь ключ → позиция, так что
+ * потоки searchBatch почти не встречаются на одной блокировке. Запись
+ * хранит сам результат индекса (View или пару итераторов); при попадании
+ * у неё ставится бит обращения, стрелка CLOCK при вытеснении пропускает
+ * записи с битом, сбрасывая его. Промахи индекса кешируются так же.
+ *
+ * Обёртка не владеет индексом. Результат в кеше живёт по правилам View:
+ * после вставки, удаления или замены по ключу нужно вызвать invalidate(key).
+ *
+ * @tparam Index Индекс с методом lookup(std::string_view) const.
+ */
+template<typename Index, typename Hash = WyHash>
+class CachedIndex {
+public:
+    using Result = decltype(std::declval<const Index&>().lookup(std::string_view{}));
+    static constexpr size_t kShardBits = 6;
+    static constexpr size_t kShards    = size_t(1) << kShardBits;
+private:
+    struct Entry {
+        std::string key;
+        Result      value{};
+        bool        referenced = false;
+    };
+    struct KeyHash {
+        Hash hash;
+        size_t operator()(std::string_view s) const { return static_cast<size_t>(hash(s)); }
+    };
+    struct alignas(64) Shard {
+        std::mutex         m;
+        std::vector<Entry> ring;    /**< Записи; ёмкость зарезервирована, ключи не двигаются */
+        std::unordered_map<std::string_view, uint32_t, KeyHash> where;  /**< Ключ → номер в ring */
+        size_t             hand    = 0;
+        size_t             hits    = 0;
+        size_t             misses  = 0;
+        uint64_t           version = 0;  /**< Растёт при каждом invalidate() и clear() */
+    };
+
+    const Index&             index;
+    Hash                     hasher;
+    size_t                   perShard;
+    std::unique_ptr<Shard[]> shards;
+
+    Shard& shardOf(std::string_view key) const {
+        return shards[hasher(key) >> (64 - kShardBits)];
+    }
+
+    // Кладёт результат в сегмент, вытесняя первую запись без бита обращения
+    void admit(Shard& s, std::string_view key, const Result& r) const {
+        if (s.ring.size() < perShard) {
+            s.ring.push_back(Entry{std::string(key), r, false});
+            s.where.emplace(s.ring.back().key, static_cast<uint32_t>(s.ring.size() - 1));
+            return;
+        }
+        while (s.ring[s.hand].referenced) {
+            s.ring[s.hand].referenced = false;
+            s.hand = (s.hand + 1) % perShard;
+        }
+        Entry& e = s.ring[s.hand];
+        s.where.erase(e.key);
+        e.key.assign(key.data(), key.size());
+        e.value = r;
+        s.where.emplace(e.key, static_cast<uint32_t>(s.hand));
+        s.hand = (s.hand + 1) % perShard;
+    }
+public:
+    /**
+     * @param index    Индекс под кешем.
+     * @param capacity Наибольшее число ключей в кеше (делится поровну между сегментами).
+     */
+    CachedIndex(const Index& index, size_t capacity, Hash hash = {})
+        : index(index), hasher(hash),
+          perShard(std::max<size_t>(1, (capacity + kShards - 1) / kShards)),
+          shards(new Shard[kShards])
+    {
+        for (size_t i = 0; i < kShards; ++i) {
+            shards[i].ring.reserve(perShard);
+            shards[i].where = decltype(shards[i].where)(2 * perShard, KeyHash{hash});
+        }
+    }
+    CachedIndex(const CachedIndex&) = delete;
+    CachedIndex& operator=(const CachedIndex&) = delete;
+
+    /**
+     * @brief Потокобезопасен; индекс при промахе читается вне блокировки.
+     *
+     * Версия сегмента запоминается до чтения индекса: если за это время
+     * в сегменте прошёл invalidate(), прочитанный результат мог устареть
+     * и в кеш не кладётся.
+     */
+    Result lookup(std::string_view key) const {
+        Shard& s = shardOf(key);
+        uint64_t seen;
+        {
+            std::lock_guard<std::mutex> lk(s.m);
+            auto it = s.where.find(key);
+            if (it != s.where.end()) {
+                Entry& e = s.ring[it->second];
+                e.referenced = true;
+                ++s.hits;
+                return e.value;
+            }
+            ++s.misses;
+            seen = s.version;
+        }
+        Result r = index.lookup(key);
+        std::lock_guard<std::mutex> lk(s.m);
+        if (s.version == seen && s.where.find(key) == s.where.end()) admit(s, key, r);
+        return r;
+    }
+
+    /**
+     * @brief Убирает ключ из кеша; вызывать после изменения индекса по этому ключу.
+     *
+     * Вызывается даже для ключа, которого в кеше нет: промах, читавший
+     * индекс до изменения, увидит новую версию сегмента и не закеширует
+     * старый результат.
+     */
+    void invalidate(std::string_view key) {
+        Shard& s = shardOf(key);
+        std::lock_guard<std::mutex> lk(s.m);
+        ++s.version;
+        auto it = s.where.find(key);
+        if (it == s.where.end()) return;
+        const uint32_t i = it->second;
+        s.where.erase(it);
+        if (i + 1 != s.ring.size()) {
+            Entry& last = s.ring.back();
+            s.where.erase(last.key);
+            s.ring[i] = std::move(last);
+            s.where.emplace(s.ring[i].key, i);
+        }
+        s.ring.pop_back();
+        if (s.hand >= s.ring.size()) s.hand = 0;
+    }
+
+    void clear() {
+        for (size_t i = 0; i < kShards; ++i) {
+            std::lock_guard<std::mutex> lk(shards[i].m);
+            shards[i].where.clear();
+            shards[i].ring.clear();
+            shards[i].hand = 0;
+            ++shards[i].version;
+        }
+    }
+
+    CacheStats stats() const {
+        CacheStats st;
+        for (size_t i = 0; i < kShards; ++i) {
+            std::lock_guard<std::mutex> lk(shards[i].m);
+            st.hits   += shards[i].hits;
+            st.misses += shards[i].misses;
+        }
+        return st;
+    }
+    void resetStats() {
+        for (size_t i = 0; i < kShards; ++i) {
+            std::lock_guard<std::mutex> lk(shards[i].m);
+            shards[i].hits = shards[i].misses = 0;
+        }
+    }
+
+    size_t capacity() const { return perShard * kShards; }
+};
+
+/**
+ * @class ShardedIndex
+ * @brief K независимых индексов, пассажиры разнесены по хешу fullName.
+ *
+ * У каждого шарда свой поток пула, привязанный к ядру (pinThisThread):
+ * шард строится на нём, поэтому его память при политике first touch
+ * выделяется на узле NUMA этого ядра, и на нём же обслуживаются пакеты
+ * запросов. Точечный lookup() идёт ровно в один шард на вызывающем
+ * потоке; lookupBatch() раскладывает ключи по шардам и отдаёт их потокам
+ * шардов; rangeSearch() и prefixSearch() опрашивают все шарды параллельно
+ * и сливают их упорядоченные ответы.
+ *
+ * Методы, использующие пул (всё, кроме lookup), нельзя вызывать из
+ * нескольких потоков одновременно, как и сам ThreadPool.
+ *
+ * @tparam Index Индекс с insert(const Passenger&) и lookup(std::string_view) const;
+ *               для диапазонов — ещё rangeSearch/prefixSearch (BasicBST, BasicRBTree).
+ */
+template<typename Index>
+class ShardedIndex {
+public:
+    using Result    = decltype(std::declval<const Index&>().lookup(std::string_view{}));
+    using MakeShard = std::function<std::unique_ptr<Index>(size_t rows)>;
+private:
+    std::vector<std::unique_ptr<Index>> shards;
+    WyHash                              hasher;
+    mutable ThreadPool                  pool;   // поток 0 — вызывающий, t > 0 обслуживает шард t - 1
+
+    size_t shardOf(std::string_view key) const { return fastRange(hasher(key), shards.size()); }
+
+    // Выполняет f(s) для каждого шарда s на его потоке
+    template<typename F>
+    void onShards(F&& f) const {
+        pool.run([&](size_t t) { if (t) f(t - 1); });
+    }
+
+    // Сливает упорядоченные по ключу ответы шардов, у каждого ключа один шард
+    template<typename Value>
+    static std::vector<Value> merge(std::vector<std::vector<Value>>& parts) {
+        std::vector<Value>  out;
+        std::vector<size_t> bounds{0};
+        for (auto& p : parts) {
+            out.insert(out.end(), p.begin(), p.end());
+            bounds.push_back(out.size());
+        }
+        auto byKey = [](const Value& a, const Value& b) { return a->fullName < b->fullName; };
+        const size_t k = parts.size();
+        for (size_t w = 1; w < k; w *= 2)
+            for (size_t i = 0; i + w < k; i += 2 * w)
+                std::inplace_merge(out.begin() + bounds[i], out.begin() + bounds[i + w],
+                                   out.begin() + bounds[std::min(i + 2 * w, k)], byKey);
+        return out;
+    }
+public:
+    /**
+     * @param data   Пассажиры; индексы хранят указатели на них.
+     * @param k      Число шардов (не меньше 1).
+     * @param make   Создаёт пустой шард под ожидаемое число строк.
+     */
+    ShardedIndex(const std::vector<Passenger>& data, size_t k, const MakeShard& make,
+                 WyHash hash = {})
+        : shards(std::max<size_t>(k, 1)), hasher(hash), pool(shards.size() + 1)
+    {
+        const size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+        std::vector<std::vector<uint32_t>> rows(shards.size());
+        for (size_t i = 0; i < data.size(); ++i)
+            rows[shardOf(data[i].fullName)].push_back(static_cast<uint32_t>(i));
+        onShards([&](size_t s) {
+            pinThisThread(s % cores);
+            shards[s] = make(rows[s].size());
+            for (uint32_t i : rows[s]) shards[s]->insert(data[i]);
+        });
+    }
+
+    size_t shardCount() const { return shards.size(); }
+
+    Result lookup(std::string_view key) const { return shards[shardOf(key)]->lookup(key); }
+
+    /** @brief results[i] — ответ на keys[i]; каждый поток шарда отвечает на свои ключи. */
+    void lookupBatch(View<std::string> keys, std::vector<Result>& results) const {
+        results.resize(keys.size());
+        std::vector<std::vector<uint32_t>> routed(shards.size());
+        for (auto& r : routed) r.reserve(keys.size() / shards.size() + 16);
+        for (size_t i = 0; i < keys.size(); ++i)
+            routed[shardOf(keys[i])].push_back(static_cast<uint32_t>(i));
+        onShards([&](size_t s) {
+            const Index& index = *shards[s];
+            for (uint32_t i : routed[s]) results[i] = index.lookup(keys[i]);
+        });
+    }
+
+    /** @brief Пассажиры с ключами из [lo, hi] в порядке ключей. */
+    auto rangeSearch(std::string_view lo, std::string_view hi) const {
+        std::vector<decltype(shards[0]->rangeSearch(lo, hi).collect())> parts(shards.size());
+        onShards([&](size_t s) { parts[s] = shards[s]->rangeSearch(lo, hi).collect(); });
+        return merge(parts);
+    }
+
+    /** @brief Пассажиры с ключами, начинающимися с prefix, в порядке ключей. */
+    auto prefixSearch(std::string_view prefix) const {
+        std::vector<decltype(shards[0]->prefixSearch(prefix).collect())> parts(shards.size());
+        onShards([&](size_t s) { parts[s] = shards[s]->prefixSearch(prefix).collect(); });
+        return merge(parts);
+    }
+
+    MemoryUsage memoryUsage() const {
+        MemoryUsage m;
+        for (const auto& s : shards) {
+            MemoryUsage u = s->memoryUsage();
+            m.nodes += u.nodes;
+            m.payload += u.payload;
+            m.keys += u.keys;
+            m.buckets += u.buckets;
+            m.arena += u.arena;
+        }
+        return m;
+    }
+};
+
+/**
+ * @class MultimapIndex
+ * @brief Базовая реализация на std::multimap с тем же интерфейсом, что у индексов.
+ *
+ * lookup() возвращает пару итераторов equal_range. Прозрачный компаратор
+ * std::less<> здесь не используется: в libstdc++ гетерогенный equal_range
+ * проходит дубликаты линейно и вдвое медленнее поиска по временной строке.
+ */
+class MultimapIndex {
+    using Map = std::multimap<std::string, const Passenger*>;
+    Map map;
+public:
+    using Range = std::pair<Map::const_iterator, Map::const_iterator>;
+
+    void insert(const Passenger& p) { map.emplace(p.fullName, &p); }
+
+    Range lookup(std::string_view key) const { return map.equal_range(std::string(key)); }
+
+    /** @brief Записи с ключами из [lo, hi]: lower_bound(lo) и upper_bound(hi). */
+    Range rangeSearch(std::string_view lo, std::string_view hi) const {
+        return {map.lower_bound(std::string(lo)), map.upper_bound(std::string(hi))};
+    }
+
+    /**
+     * @brief Записи с ключами, начинающимися с prefix.
+     *
+     * Верхняя граница — lower_bound наименьшей строки, большей всех строк
+     * с этим префиксом: префикс без хвостовых 0xff с увеличенным последним байтом.
+     */
+    Range prefixSearch(std::string_view prefix) const {
+        std::string next(prefix);
+        while (!next.empty() && static_cast<unsigned char>(next.back()) == 0xff) next.pop_back();
+        auto first = map.lower_bound(std::string(prefix));
+        if (next.empty()) return {first, map.end()};
+        next.back() = static_cast<char>(static_cast<unsigned char>(next.back()) + 1);
+        return {first, map.lower_bound(next)};
+    }
+
+    /**
+     * @brief Оценка памяти std::multimap.
+     *
+     * Узел libstdc++ — заголовок красно-чёрного дерева (цвет и три указателя)
+     * плюс пара ключ–значение; у каждой записи своя копия ключа.
+     */
+    MemoryUsage memoryUsage() const {
+        MemoryUsage m;
+        m.nodes = map.size() * (4 * sizeof(void*) + sizeof(Map::value_type));
+        for (const auto& kv : map) m.keys += stringHeapBytes(kv.first);
+        return m;
+    }
+};
+
+/**
+ * @class RowBitmap
+ * @brief Плотное множество номеров строк: бит на строку, слова по 64.
+ *
+ * Пересечение — поэлементное AND слов, обход — по установленным битам
+ * через __builtin_ctzll, поэтому множества не превращаются в векторы RowId.
+ */
+class RowBitmap {
+    std::vector<uint64_t> words;
+    size_t                rows = 0;
+public:
+    RowBitmap() = default;
+    /** @param full true — все rows строк в множестве. */
+    explicit RowBitmap(size_t rows, bool full = false)
+        : words((rows + 63) / 64, full ? ~uint64_t(0) : 0), rows(rows) {
+        if (full && rows % 64) words.back() = (uint64_t(1) << (rows % 64)) - 1;
+    }
+
+    size_t universe() const { return rows; }
+    void set(RowId r) { words[r >> 6] |= uint64_t(1) << (r & 63); }
+    bool test(RowId r) const { return words[r >> 6] >> (r & 63) & 1; }
+
+    /** @brief this &= o; @pre o.universe() == universe(). */
+    RowBitmap& operator&=(const RowBitmap& o) {
+        for (size_t i = 0; i < words.size(); ++i) words[i] &= o.words[i];
+        return *this;
+    }
+
+    size_t count() const {
+        size_t c = 0;
+        for (uint64_t w : words) c += __builtin_popcountll(w);
+        return c;
+    }
+
+    /** @brief f(r) для каждой строки по возрастанию. */
+    template<typename F>
+    void forEach(F&& f) const {
+        for (size_t i = 0; i < words.size(); ++i)
+            for (uint64_t w = words[i]; w; w &= w - 1)
+                f(static_cast<RowId>(i * 64 + __builtin_ctzll(w)));
+    }
+
+    size_t memoryBytes() const { return words.capacity() * sizeof(uint64_t); }
+};
+
+/**
+ * @struct RowQuery
+ * @brief Конъюнкция условий на столбцы PassengerStore; пустое поле — без условия.
+ */
+struct RowQuery {
+    std::optional<CabinType>           type{};    /**< cabinType == type */
+    std::optional<std::string>         port{};    /**< destinationPort == port */
+    std::optional<std::pair<int, int>> cabins{};  /**< cabinNumber в [first, second] */
+};
+
+/**
+ * @class SecondaryIndex
+ * @brief Вторичные индексы PassengerStore по типу каюты, номеру каюты и порту, с планировщиком.
+ *
+ * - cabinType: по битовой карте RowBitmap на каждое из четырёх значений;
+ * - cabinNumber: CSR — различные номера по возрастанию, смещения и строки
+ *   каждого номера по возрастанию RowId; диапазон номеров — непрерывный
+ *   отрезок массива строк;
+ * - destinationPort: RowHashTable, порт → строки по возрастанию.
+ *
+ * select() оценивает число строк каждого условия по самим индексам
+ * (размер битовой карты, отрезка CSR, списка порта). Если самое узкое
+ * условие — список, который короче прохода по словам битовой карты,
+ * план Probe идёт по его строкам и проверяет прочие условия битом
+ * типа и столбцами хранилища. Иначе план Bitmap: списки раскладываются
+ * в битовые карты, на них по месту накладывается AND карта типа, и ответ
+ * обходится по битам; запрос по одному типу обходит саму карту типа,
+ * не копируя её. Пока индекс жив, хранилище менять нельзя.
+ */
+class SecondaryIndex {
+public:
+    /** @brief План выполнения запроса. */
+    enum class Plan { Probe, Bitmap };
+private:
+    /** @brief Probe выгоднее, пока строк условия меньше words / kProbeCost. */
+    static constexpr size_t kProbeCost = 4;
+
+    const PassengerStore&    store;
+    RowBitmap                types[4];
+    size_t                   typeCounts[4] = {};
+    std::vector<int32_t>     cabinKeys;      /**< Различные номера кают по возрастанию */
+    std::vector<uint32_t>    cabinStarts;    /**< Начало строк номера i; cabinKeys.size() + 1 */
+    std::vector<RowId>       cabinRows;
+    RowHashTable             ports;
+
+    // Отрезок cabinRows для номеров из [lo, hi]
+    std::pair<size_t, size_t> cabinSlice(int lo, int hi) const {
+        if (lo > hi) return {0, 0};
+        size_t a = std::lower_bound(cabinKeys.begin(), cabinKeys.end(), lo) - cabinKeys.begin();
+        size_t b = std::upper_bound(cabinKeys.begin(), cabinKeys.end(), hi) - cabinKeys.begin();
+        return {cabinStarts[a], cabinStarts[b]};
+    }
+
+    bool matches(const RowQuery& q, RowId r) const {
+        if (q.type && !types[size_t(*q.type)].test(r)) return false;
+        if (q.cabins) {
+            int c = store.cabinNumber(r);
+            if (c < q.cabins->first || c > q.cabins->second) return false;
+        }
+        return !q.port || store.destinationPort(r) == *q.port;
+    }
+public:
+    explicit SecondaryIndex(const PassengerStore& s)
+        : store(s), ports(s.size() * 2 + 1)
+    {
+        const size_t n = store.size();
+        for (auto& b : types) b = RowBitmap(n);
+        std::vector<std::pair<int32_t, RowId>> byCabin(n);
+        for (RowId r = 0; r < n; ++r) {
+            const size_t t = size_t(store.cabinType(r));
+            types[t].set(r);
+            ++typeCounts[t];
+            byCabin[r] = {store.cabinNumber(r), r};
+            ports.insert(store.destinationPort(r), r);
+        }
+        std::sort(byCabin.begin(), byCabin.end());
+        cabinRows.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            if (i == 0 || byCabin[i].first != byCabin[i - 1].first) {
+                cabinKeys.push_back(byCabin[i].first);
+                cabinStarts.push_back(static_cast<uint32_t>(i));
+            }
+            cabinRows.push_back(byCabin[i].second);
+        }
+        cabinStarts.push_back(static_cast<uint32_t>(n));
+    }
+
+    /** @brief План, который select() выберет для q. */
+    Plan plan(const RowQuery& q) const {
+        size_t list = SIZE_MAX;
+        if (q.port)   list = std::min(list, ports.lookup(*q.port).size());
+        if (q.cabins) {
+            auto [a, b] = cabinSlice(q.cabins->first, q.cabins->second);
+            list = std::min(list, b - a);
+        }
+        const size_t words = (store.size() + 63) / 64;
+        return list != SIZE_MAX && list * kProbeCost < words ? Plan::Probe : Plan::Bitmap;
+    }
+
+    /**
+     * @brief Вызывает f(r) для каждой строки, удовлетворяющей q, по возрастанию RowId.
+     * @return Число найденных строк.
+     */
+    template<typename F>
+    size_t select(const RowQuery& q, F&& f) const {
+        const size_t n = store.size();
+        View<RowId> portRows;
+        std::pair<size_t, size_t> slice{0, 0};
+        if (q.port)   portRows = ports.lookup(*q.port);
+        if (q.cabins) slice = cabinSlice(q.cabins->first, q.cabins->second);
+        size_t found = 0;
+
+        if (plan(q) == Plan::Probe) {
+            const bool byPort = q.port && (!q.cabins || portRows.size() <= slice.second - slice.first);
+            if (byPort) {
+                for (RowId r : portRows)
+                    if (matches(q, r)) { f(r); ++found; }
+                return found;
+            }
+            // строки диапазона номеров упорядочены внутри номера, а не между номерами
+            std::vector<RowId> rows(cabinRows.begin() + slice.first, cabinRows.begin() + slice.second);
+            std::sort(rows.begin(), rows.end());
+            for (RowId r : rows)
+                if (matches(q, r)) { f(r); ++found; }
+            return found;
+        }
+
+        const RowBitmap* type = q.type ? &types[size_t(*q.type)] : nullptr;
+        if (!q.port && !q.cabins) {
+            if (type) type->forEach([&](RowId r) { f(r); ++found; });
+            else for (RowId r = 0; r < n; ++r) { f(r); ++found; }
+            return found;
+        }
+        // списки раскладываются в карту, карта типа накладывается на неё без копирования
+        RowBitmap acc(n);
+        if (q.port)
+            for (RowId r : portRows) acc.set(r);
+        if (q.cabins && q.port) {
+            RowBitmap m(n);
+            for (size_t i = slice.first; i < slice.second; ++i) m.set(cabinRows[i]);
+            acc &= m;
+        } else if (q.cabins) {
+            for (size_t i = slice.first; i < slice.second; ++i) acc.set(cabinRows[i]);
+        }
+        if (type) acc &= *type;
+        acc.forEach([&](RowId r) { f(r); ++found; });
+        return found;
+    }
+
+    /** @brief Число строк, удовлетворяющих q. */
+    size_t count(const RowQuery& q) const {
+        if (!q.port && !q.cabins) return q.type ? typeCounts[size_t(*q.type)] : store.size();
+        return select(q, [](RowId) {});
+    }
+
+    /** @brief Память индексов: таблица портов, карты типов (buckets) и CSR номеров (nodes). */
+    MemoryUsage memoryUsage() const {
+        MemoryUsage m = ports.memoryUsage();
+        for (const auto& b : types) m.buckets += b.memoryBytes();
+        m.nodes += cabinKeys.capacity() * sizeof(int32_t)
+                 + cabinStarts.capacity() * sizeof(uint32_t)
+                 + cabinRows.capacity() * sizeof(RowId);
+        return m;
+    }
+};
+
+/** @brief Индекс с lookup(key) const: найденное без копирования. */
+template<typename I>
+concept LookupIndex = requires(const I& index, std::string_view key) { index.lookup(key); };
+
+/**
+ * @brief Общий вид индекса пассажиров по ФИО.
+ *
+ * Поиск — lookup(key) или, если его нет, копирующий search(key)
+ * (ConcurrentHashTable), и учёт памяти memoryUsage(). Вставка и прочие
+ * операции концептом не требуются: статический EytzingerIndex строится
+ * конструктором.
+ */
+template<typename I>
+concept SearchIndex =
+    (LookupIndex<I> || requires(const I& index, std::string_view key) {
+        { index.search(key).size() } -> std::convertible_to<size_t>;
+    }) && requires(const I& index) {
+        { index.memoryUsage() } -> std::same_as<MemoryUsage>;
+    };
+
+/** @brief Индекс, который строится из всех записей сразу bulkBuild(data, pool). */
+template<typename I>
+concept BulkBuildIndex = requires(I& index, const std::vector<Passenger>& data, ThreadPool& pool) {
+    index.bulkBuild(data, pool);
+};
+
+/** @brief Индекс, считающий коллизии при вставке. */
+template<typename I>
+concept CollisionCounting = requires(const I& index) {
+    { index.collisionCount() } -> std::convertible_to<size_t>;
+};
+
+/** @brief Хеш-индекс, отдающий распределение ключей по корзинам. */
+template<typename I>
+concept HashStatsIndex = requires(const I& index) {
+    { index.stats() } -> std::same_as<HashStats>;
+};
+
+/** @brief Поиск ключа в индексе: lookup(), если он есть, иначе search(). */
+template<SearchIndex I>
+inline auto probeIndex(const I& index, std::string_view key) {
+    if constexpr (LookupIndex<I>) return index.lookup(key);
+    else                          return index.search(key);
+}
+
+/**
+ * @brief Выполняет пакет запросов к индексу, распределяя их по потокам пула.
+ *
+ * Индексы после построения только читаются, поэтому потоки работают
+ * без синхронизации, каждый над своим непрерывным куском ключей.
+ *
+ * @tparam Index Индекс с методом lookup(std::string_view) const.
+ * @param index Индекс.
+ * @param keys Ключи запросов.
+ * @param results Результаты, results[i] соответствует keys[i].
+ * @param pool Пул потоков.
+ */
+template<typename Index>
+void searchBatch(const Index& index, View<std::string> keys,
+                 std::vector<decltype(index.lookup(std::string_view{}))>& results,
+                 ThreadPool& pool)
+{
+    results.resize(keys.size());
+    pool.parallelFor(keys.size(), [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) results[i] = index.lookup(keys[i]);
+    });
+}
+
+/**
+ * @brief Считает память вектора пассажиров вместе со строками в куче.
+ */
+size_t passengerBytes(const std::vector<Passenger>& data) {
+    size_t bytes = data.capacity() * sizeof(Passenger);
+    for (const auto& p : data)
+        bytes += stringHeapBytes(p.fullName) + stringHeapBytes(p.cabinType)
+               + stringHeapBytes(p.destinationPort);
+    return bytes;
+}
+
+/**
+ * @brief Генерирует случайную строку из строчных букв латинского алфавита.
+ * 
+ * @param rng Генератор случайных чисел.
+ * @param len Длина строки.
+ * @return std::string Сгенерированная строка.
+ */
+std::string randomString(std::mt19937& rng, size_t len) {
+    std::uniform_int_distribution<int> dist('a', 'z');
+    std::string s(len, '\0');
+    for (char& c : s) c = static_cast<char>(dist(rng));
+    return s;
+}
+
+/**
+ * @brief Создаёт вектор пассажиров с гарантированными дубликатами ключей.
+ * 
+ * @param n Количество пассажиров.
+ * @param rng Генератор случайных чисел.
+ * @return std::vector<Passenger> Вектор пассажиров.
+ */
+std::vector<Passenger> makeData(size_t n, std::mt19937& rng) {
+    // 6.1 Ограниченный пул имён (~5 % от n)
+    size_t uniqueCnt = std::max<size_t>(10, n / 20);
+    std::vector<std::string> pool;
+    pool.reserve(uniqueCnt);
+    for (size_t i = 0; i < uniqueCnt; ++i) pool.push_back(randomString(rng, 10));
+
+    std::uniform_int_distribution<int> cabinNum(1, 1000);
+    static const std::string types[] {"Lux", "1", "2", "3"};
+    std::uniform_int_distribution<int> typeDist(0, 3);
+
+    std::vector<Passenger> v;
+    v.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        Passenger p;
+        p.fullName = pool[rng() % pool.size()];          // дубликаты гарантированы
+        p.cabinNumber = cabinNum(rng);
+        p.cabinType = types[typeDist(rng)];
+        p.destinationPort = randomString(rng, 6);
+        v.push_back(std::move(p));
+    }
+    return v;
+}
+
+/**
+ * @class PerfCounters
+ * @brief Аппаратные счётчики процессора через perf_event_open (Linux).
+ *
+ * Каждое событие открывается отдельно и только для пользовательского
+ * режима текущего потока: в виртуальных машинах PMU часто даёт лишь
+ * часть событий или ни одного, и недоступное событие не должно отключать
+ * остальные. При мультиплексировании счётчиков значение масштабируется
+ * по time_enabled / time_running. Недоступное событие (или не-Linux)
+ * даёт NaN, и в CSV соответствующие столбцы остаются nan. Работа других
+ * потоков (ThreadPool) не учитывается, поэтому для многопоточных замеров
+ * счётчики не пишутся.
+ */
+class PerfCounters {
+public:
+    enum Event { Cycles, Instructions, L1dMisses, LlcMisses, BranchMisses, DtlbMisses, EventCount };
+    static constexpr const char* kNames[EventCount] = {
+        "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "dtlb_misses"
+    };
+    using Sample = std::array<double, EventCount>;
+
+    /** @brief Счётчики вызывающего потока, открываются при первом обращении. */
+    static PerfCounters& instance() {
+        static thread_local PerfCounters counters;
+        return counters;
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (int fd : fds) if (fd >= 0) ::close(fd);
+#endif
+    }
+
+    /** @brief Открыто ли хотя бы одно событие. */
+    bool available() const {
+        for (int fd : fds) if (fd >= 0) return true;
+        return false;
+    }
+
+    static Sample none() {
+        Sample s;
+        s.fill(std::numeric_limits<double>::quiet_NaN());
+        return s;
+    }
+
+    void start() {
+#if defined(__linux__)
+        for (int fd : fds) {
+            if (fd < 0) continue;
+            ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    /** @brief Останавливает счёт и возвращает значения с прошлого start(). */
+    Sample stop() {
+        Sample s = none();
+#if defined(__linux__)
+        for (int e = 0; e < EventCount; ++e) {
+            if (fds[e] < 0) continue;
+            ::ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t v[3];      // value, time_enabled, time_running
+            if (::read(fds[e], v, sizeof(v)) != sizeof(v) || v[2] == 0) continue;
+            s[e] = double(v[0]) * double(v[1]) / double(v[2]);
+        }
+#endif
+        return s;
+    }
+private:
+    std::array<int, EventCount> fds;
+
+    PerfCounters() {
+        fds.fill(-1);
+#if defined(__linux__)
+        auto cache = [](uint64_t id, uint64_t op, uint64_t result) {
+            return id | (op << 8) | (result << 16);
+        };
+        const std::pair<uint32_t, uint64_t> events[EventCount] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                       PERF_COUNT_HW_CACHE_RESULT_MISS)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ,
+                                       PERF_COUNT_HW_CACHE_RESULT_MISS)},
+        };
+        for (int e = 0; e < EventCount; ++e) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size           = sizeof(attr);
+            attr.type           = events[e].first;
+            attr.config         = events[e].second;
+            attr.disabled       = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[e] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+};
+
+/**
+ * @struct BenchStats
+ * @brief Статистика времени одной операции по серии повторений, нс.
+ *
+ * benchmark() берёт min, median, mean и sd из средних по проходам, а p99 —
+ * из отдельно замеренных вызовов, поэтому в файлах его столбец называется
+ * *_p99_single_call_ns. summarize() считает все поля по одной выборке.
+ */
+struct BenchStats {
+    double min    = 0;      /**< Минимум */
+    double median = 0;      /**< Медиана */
+    double p99    = 0;      /**< 99-й перцентиль (в benchmark() — отдельных вызовов) */
+    double mean   = 0;      /**< Среднее */
+    double stddev = 0;      /**< Стандартное отклонение */
+    PerfCounters::Sample perf = PerfCounters::none();  /**< Счётчики на операцию (NaN — нет) */
+
+    /** @brief Статистика величины, которую не измеряли: все поля NaN. */
+    static BenchStats none() {
+        BenchStats st;
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        st.min = st.median = st.p99 = st.mean = st.stddev = nan;
+        return st;
+    }
+};
+
+/**
+ * @struct BenchConfig
+ * @brief Параметры серии измерений.
+ */
+struct BenchConfig {
+    size_t keys;            /**< Размер набора ключей */
+    size_t warmup;          /**< Прогревочные проходы (не измеряются) */
+    size_t reps;            /**< Измеряемые проходы */
+};
+
+/**
+ * @struct PhaseTimes
+ * @brief Время построения и разрушения одной структуры, нс.
+ */
+struct PhaseTimes {
+    double build    = 0;    /**< Вставка всех пассажиров */
+    double teardown = 0;    /**< Разрушение структуры */
+};
+
+/**
+ * @struct EngineResult
+ * @brief Всё, что measureEngine() измерил для одного индекса при одном размере данных.
+ *
+ * Для величин, которых у движка нет (bulkBuild у статического индекса,
+ * отдельные вставки у EytzingerIndex), остаётся NaN.
+ */
+struct EngineResult {
+    const char* name;           /**< Имя движка — префикс столбцов CSV */
+    BenchStats  lookup{};       /**< Время поиска, нс */
+    MemoryUsage memory{};       /**< Память после построения */
+    PhaseTimes  phases{};       /**< Построение вставками (или конструктором) и разрушение */
+    double      bulkBuild = std::numeric_limits<double>::quiet_NaN();  /**< bulkBuild(), нс */
+    double      maxInsert = std::numeric_limits<double>::quiet_NaN();  /**< Самая долгая вставка, нс */
+    bool        hasCollisions = false;  /**< Индекс считает коллизии */
+    size_t      collisions    = 0;      /**< collisionCount() после построения */
+    std::optional<HashStats> hashStats{};  /**< stats() после построения, если индекс их даёт */
+};
+
+/**
+ * @struct ResultRow
+ * @brief Результаты измерений для одного размера данных.
+ */
+struct ResultRow {
+    size_t      size;            /**< Размер данных */
+    BenchStats  tLinear;         /**< Время линейного поиска, нс */
+    BenchStats  tColumn;         /**< Время просмотра NameColumn, нс */
+    BenchStats  tColumnMt;       /**< Время просмотра NameColumn всеми потоками, нс */
+    std::vector<EngineResult> engines;  /**< Индексы в порядке IndexEngines */
+    size_t      dataBytes;       /**< Память самих записей Passenger */
+    size_t      storeBytes;      /**< Память тех же записей в PassengerStore */
+};
+
+/**
+ * @struct ThroughputRow
+ * @brief Пропускная способность пакетного поиска при заданном числе потоков, запросов/с.
+ */
+struct ThroughputRow {
+    size_t threads;         /**< Число потоков */
+    double bst;             /**< BST */
+    double rbt;             /**< Красно-чёрное дерево */
+    double hash;            /**< Хеш-таблица с полиномиальным хешем */
+    double wyHash;          /**< Хеш-таблица с wyhash */
+    double flat;            /**< FlatHashTable */
+    double eytz;            /**< EytzingerIndex */
+    double multimap;        /**< std::multimap */
+};
+
+/**
+ * @struct ConcurrentRow
+ * @brief Пропускная способность ConcurrentHashTable при одновременном чтении и записи.
+ */
+struct ConcurrentRow {
+    size_t readers;         /**< Число потоков-читателей */
+    size_t writers;         /**< Число потоков-писателей */
+    double readQps;         /**< Поисков в секунду, суммарно */
+    double writeOps;        /**< Операций записи (erase или insert) в секунду, суммарно */
+};
+
+/**
+ * @struct SnapshotRow
+ * @brief Запись и холодная загрузка снимка против построения индексов в памяти.
+ */
+struct SnapshotRow {
+    size_t     size;               /**< Размер набора данных */
+    size_t     fileBytes    = 0;   /**< Размер файла снимка */
+    double     write        = 0;   /**< Запись снимка, нс */
+    double     load         = 0;   /**< Открытие, mmap и проверка заголовка из холодного кеша, нс */
+    double     loadWarm     = 0;   /**< То же при файле в кеше страниц, нс */
+    double     firstQueries = 0;   /**< Первые kFirstQueries поисков после холодной загрузки, нс */
+    double     rebuild      = 0;   /**< Построение WyHashTable и EytzingerIndex по данным, нс */
+    BenchStats tHash{};            /**< Поиск через хеш-индекс снимка */
+    BenchStats tTree{};            /**< Поиск через дерево Эйтцингера снимка */
+};
+
+/**
+ * @struct IngestRow
+ * @brief Пропускная способность загрузки CSV в одном режиме.
+ */
+struct IngestRow {
+    const char* mode;       /**< Что делается с записями помимо разбора */
+    size_t      rows;       /**< Загружено строк */
+    size_t      bytes;      /**< Размер файла */
+    double      time;       /**< Полное время, нс */
+};
+
+/**
+ * @struct OrderRow
+ * @brief Дерево, построенное вставками в заданном порядке ключей.
+ */
+struct OrderRow {
+    size_t      size;       /**< Размер набора данных */
+    const char* order;      /**< Порядок вставки: random, sorted, reverse */
+    const char* engine;     /**< Дерево */
+    double      build;      /**< Построение вставками, нс */
+    size_t      height;     /**< Высота дерева */
+    BenchStats  lookup;     /**< Время поиска, нс */
+};
+
+/**
+ * @struct FilterRow
+ * @brief Поиск с фильтром Блума перед индексом и без него при заданной доле попаданий.
+ */
+struct FilterRow {
+    double      bitsPerKey;     /**< Бит фильтра на различный ключ */
+    double      hitRatio;       /**< Доля запросов с существующим ключом */
+    const char* engine;         /**< Индекс за фильтром */
+    double      fpr;            /**< Доля ложных «возможно» среди отсутствующих ключей */
+    size_t      filterBytes;    /**< Память фильтра */
+    BenchStats  plain;          /**< Поиск без фильтра, нс */
+    BenchStats  filtered;       /**< Поиск через фильтр, нс */
+};
+
+/**
+ * @struct CacheRow
+ * @brief Кеш горячих ключей над индексом при нагрузке Ципфа.
+ */
+struct CacheRow {
+    double      zipf;           /**< Показатель Ципфа */
+    size_t      capacity;       /**< Ёмкость кеша, ключей */
+    const char* engine;         /**< Индекс под кешем */
+    double      hitRate;        /**< Доля ответов из кеша за один проход запросов */
+    BenchStats  plain;          /**< Поиск без кеша, нс */
+    BenchStats  cached;         /**< Поиск через кеш, нс */
+    double      plainQps;       /**< searchBatch без кеша на всех потоках */
+    double      cachedQps;      /**< searchBatch через кеш на всех потоках */
+};
+
+/**
+ * @struct ShardRow
+ * @brief ShardedIndex с заданным числом шардов.
+ */
+struct ShardRow {
+    const char* engine;     /**< Индекс шарда */
+    size_t      shards;     /**< Число шардов K */
+    double      build    = 0;   /**< Построение на потоках шардов, нс */
+    BenchStats  point{};        /**< Точечный поиск на вызывающем потоке, нс */
+    double      batchQps = 0;   /**< lookupBatch: запросов в секунду */
+    BenchStats  prefix   = BenchStats::none();  /**< prefixSearch(3) по шардам, нс; NaN без него */
+};
+
+/**
+ * @struct PerfectRow
+ * @brief PerfectHashIndex с заданным числом корзин на ключ.
+ */
+struct PerfectRow {
+    double     bucketFactor;        /**< c: корзин c * m / log2(m) */
+    size_t     keys       = 0;      /**< Различных ключей m */
+    double     build      = 0;      /**< Построение, нс */
+    size_t     attempts   = 0;      /**< Перепробованных сидов */
+    double     bitsPerKey = 0;      /**< Биты функции на ключ */
+    BenchStats lookup{};            /**< Время поиска, нс */
+};
+
+/**
+ * @struct BatchRow
+ * @brief Пакетный поиск lookupBatch() с group одновременно идущими запросами.
+ */
+struct BatchRow {
+    const char* engine;     /**< Индекс */
+    size_t      group;      /**< Число одновременно идущих запросов G */
+    double      serial;     /**< Последовательные lookup(), нс на запрос */
+    double      batched;    /**< lookupBatch(), нс на запрос */
+};
+
+/**
+ * @struct RangeRow
+ * @brief Время прохода по диапазону или префиксу ключей на одном движке.
+ */
+struct RangeRow {
+    std::string query;      /**< Вид запроса: prefix<длина> или range */
+    const char* engine;     /**< Движок */
+    double      rows;       /**< Среднее число найденных пассажиров на запрос */
+    BenchStats  time;       /**< Время запроса, нс */
+};
+
+/**
+ * @struct SecondaryRow
+ * @brief Запрос по вторичным столбцам: SecondaryIndex против прохода по записям.
+ */
+struct SecondaryRow {
+    const char* query;      /**< Вид запроса: набор условий */
+    const char* plan;       /**< План SecondaryIndex: probe или bitmap */
+    double      rows;       /**< Среднее число найденных строк на запрос */
+    BenchStats  index{};    /**< SecondaryIndex::select, нс */
+    BenchStats  scan{};     /**< Проход по всем записям с проверкой условий, нс */
+};
+
+/**
+ * @enum OpKind
+ * @brief Вид операции смешанной нагрузки.
+ */
+enum class OpKind { Lookup, Insert, Erase, Update };
+
+/**
+ * @struct MixedOp
+ * @brief Одна операция смешанной нагрузки; ключ операции — p->fullName.
+ */
+struct MixedOp {
+    OpKind           kind;
+    const Passenger* p;             /**< Запись, которую ищут, вставляют или удаляют */
+    const Passenger* to = nullptr;  /**< Новая версия записи для Update */
+};
+
+/**
+ * @struct MixedRow
+ * @brief Задержка отдельных операций смешанной нагрузки на одной структуре, нс.
+ */
+struct MixedRow {
+    const char* engine;         /**< Имя структуры */
+    BenchStats  lookup{};       /**< lookup() */
+    BenchStats  insert{};       /**< insert() */
+    BenchStats  erase{};        /**< erase(key, p) */
+    BenchStats  update{};       /**< update() на месте */
+    size_t      counts[4] = {}; /**< Число операций каждого вида (в порядке OpKind) */
+};
+
+/**
+ * @brief Функция для измерения времени выполнения переданной функции.
+ * 
+ * @tparam F Тип callable объекта (лямбда, функция и т.п.).
  * @param f Объект функции для измерения.
  * @return double Время выполнения в наносекундах.
  */
@@ -381,58 +5312,1521 @@ static double timeIt(F&& f) {
 }
 
 /**
- * @brief Точка входа программы.
- * 
- * Генерирует данные разного размера, строит все структуры,
- * замеряет время поиска, сохраняет результаты в CSV.
- * 
- * @return int Код возврата (0 — успех).
+ * @brief Не даёт компилятору выбросить вычисление значения.
+ *
+ * Пустая ассемблерная вставка «читает» значение и «портит» память,
+ * поэтому результат поиска должен быть вычислен и не может быть вынесен из цикла.
+ */
+template<typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief Считает статистику по выборке.
+ *
+ * @param samples Выборка (сортируется на месте).
+ * @return BenchStats Минимум, медиана, p99, среднее и стандартное отклонение.
+ */
+static BenchStats summarize(std::vector<double>& samples) {
+    BenchStats st;
+    if (samples.empty()) return st;
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    st.min    = samples.front();
+    st.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    st.p99    = samples[std::min(n - 1, static_cast<size_t>(std::ceil(0.99 * n)) - 1)];
+    double sum = 0;
+    for (double x : samples) sum += x;
+    st.mean = sum / n;
+    double sq = 0;
+    for (double x : samples) sq += (x - st.mean) * (x - st.mean);
+    st.stddev = n > 1 ? std::sqrt(sq / (n - 1)) : 0;
+    return st;
+}
+
+/**
+ * @brief Составляет набор ключей запросов: попадания из данных и заведомые промахи.
+ *
+ * Промахи — случайные строки той же длины; совпасть с пулом имён они
+ * могут лишь с вероятностью порядка n / 26^10.
+ *
+ * @param data Данные.
+ * @param count Число ключей.
+ * @param hitRatio Доля ключей, которые есть в данных.
+ * @param rng Генератор случайных чисел.
+ * @return std::vector<std::string> Ключи в случайном порядке.
+ */
+static std::vector<std::string> makeQueries(const std::vector<Passenger>& data, size_t count,
+                                            double hitRatio, std::mt19937& rng)
+{
+    std::uniform_int_distribution<size_t> pick(0, data.size() - 1);
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    size_t hits = static_cast<size_t>(count * hitRatio);
+    for (size_t i = 0; i < count; ++i)
+        keys.push_back(i < hits ? data[pick(rng)].fullName
+                                : randomString(rng, data[pick(rng)].fullName.size()));
+    std::shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+/**
+ * @class ZipfDistribution
+ * @brief Ранги [0, n) с вероятностью, пропорциональной 1 / (rank + 1)^s.
+ *
+ * Функция распределения считается один раз, выборка — двоичный поиск
+ * по ней. s = 0 — равномерное распределение.
+ */
+class ZipfDistribution {
+    std::vector<double> cdf;
+public:
+    ZipfDistribution(size_t n, double s) : cdf(std::max<size_t>(n, 1)) {
+        double sum = 0;
+        for (size_t i = 0; i < cdf.size(); ++i) cdf[i] = sum += std::pow(double(i + 1), -s);
+        for (double& c : cdf) c /= sum;
+    }
+
+    template<typename Rng>
+    size_t operator()(Rng& rng) const {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        size_t r = static_cast<size_t>(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+        return std::min(r, cdf.size() - 1);
+    }
+};
+
+/**
+ * @brief Создаёт набор запросов, в котором различные ключи data встречаются по закону Ципфа.
+ *
+ * Ранги раздаются ключам в случайном порядке, чтобы частые ключи не
+ * совпадали с порядком вставки. Все запросы — попадания.
+ *
+ * @param s Показатель Ципфа (0 — равномерно, около 1 — типичная перекошенная нагрузка).
+ */
+static std::vector<std::string> makeZipfQueries(const std::vector<Passenger>& data, size_t count,
+                                                double s, std::mt19937& rng)
+{
+    std::vector<std::string_view> names;
+    names.reserve(data.size());
+    for (const auto& p : data) names.push_back(p.fullName);
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    std::shuffle(names.begin(), names.end(), rng);
+    ZipfDistribution zipf(names.size(), s);
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i) keys.emplace_back(names[zipf(rng)]);
+    return keys;
+}
+
+/** @brief Медианная стоимость пустого timeIt(), нс; считается один раз. */
+static double timerOverhead() {
+    static const double overhead = [] {
+        std::vector<double> t(10'001);
+        for (double& x : t) x = timeIt([] {});
+        return summarize(t).median;
+    }();
+    return overhead;
+}
+
+/** @brief Сколько отдельных вызовов замеряет benchmark() для p99 (не больше cfg.reps проходов). */
+constexpr size_t kTailSamples = 10'000;
+
+/**
+ * @brief Измеряет время одного поиска: прогрев, затем серия проходов по набору ключей.
+ *
+ * Каждый проход выполняет op для всех ключей в новом случайном порядке;
+ * выборка — среднее время одного вызова в каждом проходе, что снимает
+ * ограничение разрешения часов на одиночном вызове. По этой выборке
+ * считаются min, median, mean и sd. Хвост среднее прохода не видит,
+ * поэтому p99 берётся из отдельных проходов, где каждый вызов замеряется
+ * сам по себе, а из замера вычитается timerOverhead().
+ *
+ * @tparam Op  Callable вида op(const Key&), возвращающий результат поиска.
+ * @tparam Key Запрос: обычно ключ-строка; запросы строятся заранее, вне замера.
+ * @return BenchStats Статистика по проходам, нс на поиск.
+ */
+template<typename Op, typename Key>
+static BenchStats benchmark(Op&& op, std::vector<Key> keys,
+                            const BenchConfig& cfg, std::mt19937& rng)
+{
+    keys.resize(std::min(keys.size(), cfg.keys));
+    auto pass = [&] { for (const auto& k : keys) doNotOptimize(op(k)); };
+    for (size_t i = 0; i < cfg.warmup; ++i) pass();
+    std::vector<double> samples;
+    samples.reserve(cfg.reps);
+    PerfCounters& counters = PerfCounters::instance();
+    PerfCounters::Sample total{};
+    for (size_t i = 0; i < cfg.reps; ++i) {
+        std::shuffle(keys.begin(), keys.end(), rng);
+        counters.start();
+        samples.push_back(timeIt(pass) / keys.size());
+        PerfCounters::Sample s = counters.stop();
+        for (int e = 0; e < PerfCounters::EventCount; ++e) total[e] += s[e];
+    }
+    BenchStats st = summarize(samples);
+    for (int e = 0; e < PerfCounters::EventCount; ++e)
+        st.perf[e] = total[e] / (double(cfg.reps) * keys.size());
+
+    const size_t tailPasses =
+        keys.empty() ? 0 : std::min(cfg.reps, (kTailSamples + keys.size() - 1) / keys.size());
+    const double clock = timerOverhead();
+    std::vector<double> single;
+    single.reserve(tailPasses * keys.size());
+    for (size_t i = 0; i < tailPasses; ++i) {
+        std::shuffle(keys.begin(), keys.end(), rng);
+        for (const auto& k : keys)
+            single.push_back(std::max(0.0, timeIt([&] { doNotOptimize(op(k)); }) - clock));
+    }
+    st.p99 = summarize(single).p99;
+    return st;
+}
+
+/**
+ * @brief Измеряет пропускную способность searchBatch (лучшая из нескольких попыток).
+ *
+ * @return double Запросов в секунду.
+ */
+template<typename Index>
+static double measureQps(const Index& index, View<std::string> keys, ThreadPool& pool) {
+    std::vector<decltype(index.lookup(std::string_view{}))> results;
+    double best = 0;
+    for (int rep = 0; rep < 3; ++rep) {
+        double t = timeIt([&] { searchBatch(index, keys, results, pool); });
+        if (rep == 0 || t < best) best = t;
+    }
+    return keys.size() / (best * 1e-9);
+}
+
+/**
+ * @brief Составляет смешанную нагрузку над индексом, построенным из всех записей data.
+ *
+ * 70% поисков, по 10% удалений, вставок ранее удалённых записей и замен
+ * записи на её копию shadow[i] с тем же ключом (смена каюты на месте).
+ * Последовательность зависит только от rng, поэтому одинакова для всех структур.
+ * Если в индексе не осталось ни одной записи, удаление и замена заменяются
+ * вставкой, а вставка без удалённых записей — поиском.
+ */
+static std::vector<MixedOp> makeMixedOps(const std::vector<Passenger>& data,
+                                         const std::vector<Passenger>& shadow,
+                                         size_t count, std::mt19937& rng)
+{
+    const size_t n = data.size();
+    std::vector<uint8_t> state(n, 1);   // 0 — удалена, 1 — в индексе data[i], 2 — shadow[i]
+    std::vector<size_t>  absent;
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    std::uniform_int_distribution<int>    roll(0, 99);
+    auto present = [&] {
+        size_t i;
+        do i = pick(rng); while (!state[i]);
+        return i;
+    };
+    auto version = [&](size_t i) { return state[i] == 1 ? &data[i] : &shadow[i]; };
+    std::vector<MixedOp> ops;
+    ops.reserve(count);
+    while (ops.size() < count) {
+        int r = roll(rng);
+        // все записи удалены: удалять и менять нечего, вместо этого вставка
+        if (absent.size() == n && ((r >= 70 && r < 80) || r >= 90)) r = 80;
+        if (r < 70 || (r >= 80 && r < 90 && absent.empty())) {
+            ops.push_back({OpKind::Lookup, &data[pick(rng)]});
+        } else if (r < 80) {
+            size_t i = present();
+            ops.push_back({OpKind::Erase, version(i)});
+            state[i] = 0;
+            absent.push_back(i);
+        } else if (r < 90) {
+            std::swap(absent[pick(rng) % absent.size()], absent.back());
+            size_t i = absent.back();
+            absent.pop_back();
+            ops.push_back({OpKind::Insert, &data[i]});
+            state[i] = 1;
+        } else {
+            size_t i = present();
+            const Passenger* from = version(i);
+            state[i] = 3 - state[i];
+            ops.push_back({OpKind::Update, from, version(i)});
+        }
+    }
+    return ops;
+}
+
+/**
+ * @brief Выполняет смешанную нагрузку, замеряя каждую операцию отдельно.
+ *
+ * В задержку входит и стоимость вызова часов (см. строку timer в mixed_ops.csv).
+ */
+template<typename Index>
+static MixedRow runMixed(const char* engine, Index& index, const std::vector<MixedOp>& ops) {
+    std::vector<double> samples[4];
+    for (const MixedOp& op : ops) {
+        std::string_view k = op.p->fullName;
+        double t = 0;
+        switch (op.kind) {
+        case OpKind::Lookup: t = timeIt([&] { doNotOptimize(index.lookup(k)); });          break;
+        case OpKind::Insert: t = timeIt([&] { index.insert(*op.p); });                    break;
+        case OpKind::Erase:  t = timeIt([&] { doNotOptimize(index.erase(k, op.p)); });     break;
+        case OpKind::Update: t = timeIt([&] { doNotOptimize(index.update(k, op.p, *op.to)); }); break;
+        }
+        samples[static_cast<int>(op.kind)].push_back(t);
+    }
+    MixedRow row{.engine = engine};
+    for (int i = 0; i < 4; ++i) row.counts[i] = samples[i].size();
+    row.lookup = summarize(samples[0]);
+    row.insert = summarize(samples[1]);
+    row.erase  = summarize(samples[2]);
+    row.update = summarize(samples[3]);
+    return row;
+}
+
+/**
+ * @brief Нагружает таблицу readers читателями и writers писателями в течение seconds.
+ *
+ * Читатели по кругу ищут ключи keys через visit(). Каждый писатель
+ * владеет своей долей записей data и попеременно удаляет и снова
+ * вставляет их, поэтому содержимое таблицы почти не меняется.
+ */
+template<typename Table>
+static ConcurrentRow measureConcurrent(Table& table, const std::vector<Passenger>& data,
+                                       View<std::string> keys, size_t readers, size_t writers,
+                                       double seconds, uint32_t seed)
+{
+    ThreadPool pool(readers + writers);
+    std::vector<size_t> ops(readers + writers, 0);
+    auto deadline = std::chrono::steady_clock::now()
+                  + std::chrono::nanoseconds(static_cast<int64_t>(seconds * 1e9));
+    pool.run([&](size_t id) {
+        size_t count = 0;
+        if (id < writers) {
+            std::mt19937 rng(seed + static_cast<uint32_t>(id));
+            std::uniform_int_distribution<size_t> pick(0, (data.size() - 1 - id) / writers);
+            while (std::chrono::steady_clock::now() < deadline) {
+                for (int j = 0; j < 64; ++j) {
+                    const Passenger& p = data[pick(rng) * writers + id];
+                    table.erase(p.fullName, &p);
+                    table.insert(p);
+                    count += 2;
+                }
+            }
+        } else {
+            size_t i = id * 7919 % keys.size(), found = 0;
+            while (std::chrono::steady_clock::now() < deadline) {
+                for (int j = 0; j < 256; ++j) {
+                    found += table.visit(keys[i], [](PayloadView v) { doNotOptimize(v.size()); });
+                    if (++i == keys.size()) i = 0;
+                }
+                count += 256;
+            }
+            doNotOptimize(found);
+        }
+        ops[id] = count;
+    });
+    size_t reads = 0, writes = 0;
+    for (size_t id = 0; id < ops.size(); ++id) (id < writers ? writes : reads) += ops[id];
+    return {readers, writers, reads / seconds, writes / seconds};
+}
+
+/**
+ * @struct EngineInput
+ * @brief Исходные данные, из которых measureEngine() строит индекс.
+ */
+struct EngineInput {
+    const std::vector<Passenger>& data;    /**< Записи */
+    const PassengerStore&         store;   /**< Те же записи по столбцам */
+    ThreadPool&                   pool;    /**< Потоки для bulkBuild и статических индексов */
+    std::mt19937&                 rng;     /**< Источник сидов хеш-функций */
+};
+
+/** @brief Пустой индекс конструктором по умолчанию. */
+struct MakeEmpty {
+    static constexpr bool kBuilt = false;
+    template<typename I> static std::unique_ptr<I> make(const EngineInput&) {
+        return std::make_unique<I>();
+    }
+};
+
+/** @brief Пустая хеш-таблица на 2n + 1 корзину; Hash = void — хеш по умолчанию без сида. */
+template<typename Hash = void>
+struct MakeSized {
+    static constexpr bool kBuilt = false;
+    template<typename I> static std::unique_ptr<I> make(const EngineInput& in) {
+        const size_t buckets = in.data.size() * 2 + 1;
+        if constexpr (std::is_void_v<Hash>) return std::make_unique<I>(buckets);
+        else                                return std::make_unique<I>(buckets, Hash{in.rng()});
+    }
+};
+
+/** @brief Хеш-таблица, размер которой заранее неизвестен: растёт с 16 корзин. */
+template<typename Hash>
+struct MakeGrowing {
+    static constexpr bool kBuilt = false;
+    template<typename I> static std::unique_ptr<I> make(const EngineInput& in) {
+        return std::make_unique<I>(16, Hash{in.rng()});
+    }
+};
+
+/** @brief Статический индекс: строится целиком конструктором I(data, pool). */
+struct MakeStatic {
+    static constexpr bool kBuilt = true;
+    template<typename I> static std::unique_ptr<I> make(const EngineInput& in) {
+        return std::make_unique<I>(in.data, in.pool);
+    }
+};
+
+/** @brief Вставка i-й записи как Passenger (индекс хранит указатели). */
+struct PassengerSource {
+    template<typename I> static void insert(I& index, const EngineInput& in, size_t i) {
+        index.insert(in.data[i]);
+    }
+};
+
+/** @brief Вставка i-й строки PassengerStore (индекс хранит RowId). */
+struct RowSource {
+    template<typename I> static void insert(I& index, const EngineInput& in, size_t i) {
+        index.insert(in.store.name(static_cast<RowId>(i)), static_cast<RowId>(i));
+    }
+};
+
+/**
+ * @struct EngineName
+ * @brief Строковый литерал как параметр шаблона: Engine<BST, "bst">.
+ */
+template<size_t N>
+struct EngineName {
+    char str[N];
+    constexpr EngineName(const char (&s)[N]) { std::copy_n(s, N, str); }
+};
+
+/**
+ * @struct Engine
+ * @brief Описание движка для бенчмарка: тип индекса, имя столбцов, способ построения.
+ *
+ * Тип ключа и политика хеширования входят в сам Index (BasicBST<FixedKey>,
+ * BasicHashTable<WyHash>), поэтому каждый вариант — отдельная
+ * специализация кода поиска, без виртуальных вызовов.
+ *
+ * @tparam I      Индекс.
+ * @tparam Name   Имя движка в CSV.
+ * @tparam Make   Как создать индекс (MakeEmpty, MakeSized, MakeGrowing, MakeStatic).
+ * @tparam Source Как вставить i-ю запись (PassengerSource, RowSource).
+ */
+template<SearchIndex I, EngineName Name, typename Make = MakeEmpty,
+         typename Source = PassengerSource>
+struct Engine {
+    using Index  = I;
+    using Maker  = Make;
+    using Rows   = Source;
+    static constexpr const char* kName = Name.str;
+};
+
+/** @brief Список типов движков, который measureEngines() проходит по порядку. */
+template<typename... Engines>
+struct EngineList {};
+
+/**
+ * @brief Строит индекс движка E, измеряет поиск, память и построение.
+ *
+ * Время построения — один замер всего цикла вставок, как у bulkBuild()
+ * и конструкторов; на этом же экземпляре замеряются поиск и память,
+ * затем разрушение. После него отдельные экземпляры строят bulkBuild(),
+ * если индекс его умеет, и проход для maxInsert: там каждая вставка
+ * замеряется отдельно, за вычетом timerOverhead(). Эти проходы
+ * идут на прогретом распределителе и на build не влияют.
+ */
+template<typename E>
+static EngineResult measureEngine(const EngineInput& in, const std::vector<std::string>& keys,
+                                  const BenchConfig& cfg) {
+    using I      = typename E::Index;
+    using Make   = typename E::Maker;
+    using Source = typename E::Rows;
+    const size_t n = in.data.size();
+    EngineResult r{.name = E::kName};
+
+    std::unique_ptr<I> index;
+    if constexpr (Make::kBuilt) {
+        r.phases.build = timeIt([&] { index = Make::template make<I>(in); });
+    } else {
+        index = Make::template make<I>(in);
+        r.phases.build = timeIt([&] {
+            for (size_t i = 0; i < n; ++i) Source::insert(*index, in, i);
+        });
+    }
+    r.lookup = benchmark([&](const std::string& k) { return probeIndex(*index, k); },
+                         keys, cfg, in.rng);
+    r.memory = index->memoryUsage();
+    if constexpr (CollisionCounting<I>) {
+        r.hasCollisions = true;
+        r.collisions    = index->collisionCount();
+    }
+    if constexpr (HashStatsIndex<I>) r.hashStats = index->stats();
+    r.phases.teardown = timeIt([&] { index.reset(); });
+
+    if constexpr (!Make::kBuilt && BulkBuildIndex<I> && std::is_same_v<Source, PassengerSource>) {
+        index = Make::template make<I>(in);
+        r.bulkBuild = timeIt([&] { index->bulkBuild(in.data, in.pool); });
+        index.reset();
+    }
+    if constexpr (!Make::kBuilt) {
+        index = Make::template make<I>(in);
+        const double clock = timerOverhead();
+        r.maxInsert = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const double t = timeIt([&] { Source::insert(*index, in, i); }) - clock;
+            r.maxInsert = std::max(r.maxInsert, t);
+        }
+        index.reset();
+    }
+    return r;
+}
+
+/**
+ * @brief measureEngine() для каждого движка списка по порядку.
+ *
+ * @param only Имена движков, которые нужно измерить; пустой — все.
  */
-int main() {
+template<typename... Engines>
+static std::vector<EngineResult> measureEngines(EngineList<Engines...>, const EngineInput& in,
+                                                const std::vector<std::string>& keys,
+                                                const BenchConfig& cfg,
+                                                const std::vector<std::string>& only = {}) {
+    std::vector<EngineResult> results;
+    auto run = [&]<typename E>() {
+        if (only.empty() || std::find(only.begin(), only.end(), E::kName) != only.end())
+            results.push_back(measureEngine<E>(in, keys, cfg));
+    };
+    (run.template operator()<Engines>(), ...);
+    return results;
+}
+
+/**
+ * @brief Индексы, которые сравниваются на каждом размере данных (search_times.csv).
+ *
+ * Новый движок добавляется одной строкой: тип, имя столбцов и способ построения.
+ */
+using IndexEngines = EngineList<
+    Engine<BST,                   "bst">,
+    Engine<RBTree,                "rbt">,
+    Engine<FixedBST,              "bst_fixed">,
+    Engine<FixedRBTree,           "rbt_fixed">,
+    Engine<HashTable,             "hash",      MakeSized<>>,
+    Engine<WyHashTable,           "hash_wy",   MakeSized<WyHash>>,
+    Engine<WyHashTable,           "hash_grow", MakeGrowing<WyHash>>,
+    Engine<RowRBTree,             "rbt_row",   MakeEmpty, RowSource>,
+    Engine<RowHashTable,          "hash_row",  MakeSized<WyHash>, RowSource>,
+    Engine<FlatHashTable,         "flat",      MakeSized<WyHash>>,
+    Engine<EytzingerIndex,        "eytz",      MakeStatic>,
+    Engine<PerfectHashIndex,      "phf",       MakeStatic>,
+    Engine<RadixTrie,             "trie">,
+    Engine<MultimapIndex,         "multimap">,
+    Engine<ConcurrentHashTable<>, "hash_concurrent", MakeSized<WyHash>>>;
+
+/**
+ * @brief Просит ОС выбросить страницы файла из кеша, чтобы следующая загрузка была холодной.
+ *
+ * Без posix_fadvise замер загрузки остаётся тёплым.
+ */
+static void dropPageCache(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    ::fsync(fd);
+#if defined(POSIX_FADV_DONTNEED)
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    ::close(fd);
+#else
+    (void)path;
+#endif
+}
+
+/**
+ * @struct RunOptions
+ * @brief Параметры запуска, заданные в командной строке (см. parseArgs()).
+ *
+ * По умолчанию запуск повторяет прежний: все размеры и движки, равномерные
+ * ключи с 80% попаданий. Зерно без --seed берётся из std::random_device
+ * и всё равно записывается в run.json, так что любой прогон можно повторить.
+ */
+struct RunOptions {
     std::vector<size_t> sizes {
         100, 1'000, 5'000, 10'000, 50'000, 100'000,
         200'000, 500'000, 750'000, 1'000'000
     };
-    std::mt19937 rng(std::random_device{}());
+    std::optional<uint32_t>  seed;          /**< Зерно генератора данных и запросов */
+    std::vector<std::string> engines;       /**< Движки IndexEngines в прогоне; пусто — все */
+    std::vector<size_t>      threads;       /**< Числа потоков; пусто — 1, 2, 4, ... до числа ядер */
+    double                   zipf     = 0;  /**< Показатель Ципфа ключей-попаданий; 0 — равномерно */
+    double                   hitRatio = 0.8;  /**< Доля запросов, ключ которых существует */
+    size_t                   reps     = 31; /**< Измеряемые проходы по набору ключей */
+    bool                     csv       = true;   /**< search_times / build_times в CSV */
+    bool                     json      = false;  /**< Те же результаты в search_times.json */
+    bool                     sweepOnly = false;  /**< Только прогон по размерам, без сценариев */
+    bool                     help      = false;  /**< Показать справку и выйти */
+    std::string              commandLine;        /**< Исходная строка запуска */
+};
+
+static const char* const kUsage =
+    "Использование: main [параметры]\n"
+    "  --sizes N,N,...        размеры данных (по умолчанию 100..1000000);\n"
+    "                         сценарии после прогона — на наибольшем, не меньше 1000\n"
+    "  --seed S               зерно генератора (по умолчанию случайное)\n"
+    "  --engines a,b,...      движки прогона по размерам (по умолчанию все)\n"
+    "  --threads T,T,...      числа потоков для сценариев пропускной способности\n"
+    "  --dist uniform|zipf[:S] распределение ключей-попаданий (S по умолчанию 0.99)\n"
+    "  --hit-ratio X          доля попаданий, 0..1 (по умолчанию 0.8)\n"
+    "  --reps N               измеряемые проходы (по умолчанию 31)\n"
+    "  --format csv|json|both формат search_times / build_times\n"
+    "  --sweep-only           только прогон по размерам и снимок\n"
+    "  --help                 эта справка\n";
+
+/** @throws std::invalid_argument Если s — не число типа T целиком. */
+template<typename T>
+static T parseNumber(std::string_view s, std::string_view option) {
+    T v{};
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (ec != std::errc() || end != s.data() + s.size() || s.empty())
+        throw std::invalid_argument(std::string(option) + ": не число: " + std::string(s));
+    return v;
+}
+
+/** @brief Разбивает список через запятую; пустых элементов не бывает. */
+static std::vector<std::string_view> splitList(std::string_view s, std::string_view option) {
+    std::vector<std::string_view> items;
+    for (size_t pos = 0;;) {
+        size_t comma = s.find(',', pos);
+        std::string_view item = s.substr(pos, comma - pos);
+        if (item.empty()) throw std::invalid_argument(std::string(option) + ": пустой элемент");
+        items.push_back(item);
+        if (comma == std::string_view::npos) return items;
+        pos = comma + 1;
+    }
+}
+
+/** @brief Имена движков списка в порядке столбцов. */
+template<typename... Engines>
+static std::vector<std::string_view> engineNames(EngineList<Engines...>) {
+    return {Engines::kName...};
+}
+
+/**
+ * @brief Разбирает аргументы командной строки.
+ *
+ * Значение передаётся следующим аргументом или через '=': "--reps 5"
+ * и "--reps=5" равнозначны.
+ *
+ * @throws std::invalid_argument Неизвестный параметр, нет значения
+ *         или оно вне допустимого диапазона; what() — для пользователя.
+ */
+static RunOptions parseArgs(int argc, char** argv) {
+    RunOptions o;
+    for (int i = 0; i < argc; ++i) o.commandLine += (i ? " " : "") + std::string(argv[i]);
+    const auto known = engineNames(IndexEngines{});
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i], value;
+        size_t eq = arg.find('=');
+        if (eq != std::string_view::npos) {
+            value = arg.substr(eq + 1);
+            arg   = arg.substr(0, eq);
+        }
+        auto next = [&]() -> std::string_view {
+            if (eq != std::string_view::npos) return value;
+            if (i + 1 >= argc) throw std::invalid_argument(std::string(arg) + ": нет значения");
+            return argv[++i];
+        };
+        if (arg == "--sizes") {
+            o.sizes.clear();
+            for (auto v : splitList(next(), arg)) o.sizes.push_back(parseNumber<size_t>(v, arg));
+            if (std::count(o.sizes.begin(), o.sizes.end(), 0u))
+                throw std::invalid_argument("--sizes: размер должен быть больше 0");
+        } else if (arg == "--seed") {
+            o.seed = parseNumber<uint32_t>(next(), arg);
+        } else if (arg == "--engines") {
+            o.engines.clear();
+            for (auto v : splitList(next(), arg)) {
+                if (std::find(known.begin(), known.end(), v) == known.end())
+                    throw std::invalid_argument("--engines: неизвестный движок " + std::string(v));
+                o.engines.emplace_back(v);
+            }
+        } else if (arg == "--threads") {
+            o.threads.clear();
+            for (auto v : splitList(next(), arg)) o.threads.push_back(parseNumber<size_t>(v, arg));
+            if (std::count(o.threads.begin(), o.threads.end(), 0u))
+                throw std::invalid_argument("--threads: нужен хотя бы один поток");
+        } else if (arg == "--dist") {
+            std::string_view d = next();
+            if (d == "uniform")    o.zipf = 0;
+            else if (d == "zipf")  o.zipf = 0.99;
+            else if (d.starts_with("zipf:")) o.zipf = parseNumber<double>(d.substr(5), arg);
+            else throw std::invalid_argument("--dist: ожидается uniform или zipf[:S]");
+            if (!(o.zipf >= 0)) throw std::invalid_argument("--dist: показатель Ципфа < 0");
+        } else if (arg == "--hit-ratio") {
+            o.hitRatio = parseNumber<double>(next(), arg);
+            if (!(o.hitRatio >= 0 && o.hitRatio <= 1))
+                throw std::invalid_argument("--hit-ratio: ожидается число от 0 до 1");
+        } else if (arg == "--reps") {
+            o.reps = parseNumber<size_t>(next(), arg);
+            if (o.reps == 0) throw std::invalid_argument("--reps: нужен хотя бы один проход");
+        } else if (arg == "--format") {
+            std::string_view f = next();
+            if (f != "csv" && f != "json" && f != "both")
+                throw std::invalid_argument("--format: ожидается csv, json или both");
+            o.csv  = f != "json";
+            o.json = f != "csv";
+        } else if (arg == "--sweep-only" && eq == std::string_view::npos) {
+            o.sweepOnly = true;
+        } else if ((arg == "--help" || arg == "-h") && eq == std::string_view::npos) {
+            o.help = true;
+        } else {
+            throw std::invalid_argument("неизвестный параметр " + std::string(arg));
+        }
+    }
+    return o;
+}
+
+/**
+ * @brief Набор запросов прогона: доля hitRatio попаданий, остальное — промахи.
+ *
+ * При zipf > 0 попадания распределены по закону Ципфа (makeZipfQueries()),
+ * иначе равномерно (makeQueries()).
+ */
+static std::vector<std::string> makeWorkload(const std::vector<Passenger>& data, size_t count,
+                                             const RunOptions& o, std::mt19937& rng)
+{
+    if (o.zipf == 0) return makeQueries(data, count, o.hitRatio, rng);
+    size_t hits = static_cast<size_t>(count * o.hitRatio);
+    auto keys = makeZipfQueries(data, hits, o.zipf, rng);
+    for (auto& miss : makeQueries(data, count - hits, 0.0, rng)) keys.push_back(std::move(miss));
+    std::shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+/** @brief Строка JSON в кавычках с экранированием. */
+static std::string jsonString(std::string_view s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof buf, "\\u%04x", c);
+            out += buf;
+        }
+        else out += c;
+    }
+    return out + '"';
+}
+
+/** @brief Число JSON; NaN и бесконечности (нет величины) — null. */
+static std::string jsonNumber(double v) {
+    if (!std::isfinite(v)) return "null";
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof buf, v);   // кратчайшая точная запись
+    return ec == std::errc() ? std::string(buf, end) : "null";
+}
+
+/** @brief Модель процессора из /proc/cpuinfo; пустая строка, если её не узнать. */
+static std::string cpuModel() {
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(in, line)) {
+        for (const char* key : {"model name", "Hardware", "Processor"}) {
+            if (!line.starts_with(key)) continue;
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            size_t b = line.find_first_not_of(" \t", colon + 1);
+            return b == std::string::npos ? std::string() : line.substr(b);
+        }
+    }
+    return {};
+}
+
+/**
+ * @brief Флаги сборки.
+ *
+ * Строку флагов компилятор не сообщает; её передают при сборке:
+ * -DBENCH_CXXFLAGS="\"-O2 -march=native\"". Без неё — "unknown".
+ */
+static std::string buildFlags() {
+#ifdef BENCH_CXXFLAGS
+    return BENCH_CXXFLAGS;
+#else
+    return "unknown";
+#endif
+}
+
+/** @brief Предопределённые макросы, влияющие на результаты: оптимизация, NDEBUG, SIMD, санитайзеры. */
+static std::vector<std::string> buildMacros() {
+    std::vector<std::string> m;
+#ifdef __OPTIMIZE__
+    m.push_back("__OPTIMIZE__");
+#endif
+#ifdef __OPTIMIZE_SIZE__
+    m.push_back("__OPTIMIZE_SIZE__");
+#endif
+#ifdef NDEBUG
+    m.push_back("NDEBUG");
+#endif
+#ifdef __AVX2__
+    m.push_back("__AVX2__");
+#endif
+#ifdef __SSE4_2__
+    m.push_back("__SSE4_2__");
+#endif
+#ifdef __ARM_NEON
+    m.push_back("__ARM_NEON");
+#endif
+#ifdef __SANITIZE_ADDRESS__
+    m.push_back("__SANITIZE_ADDRESS__");
+#endif
+    return m;
+}
+
+/**
+ * @brief Записывает окружение и параметры прогона объектом JSON.
+ *
+ * Этого достаточно, чтобы повторить прогон на тех же данных и понять,
+ * сравнимы ли результаты двух сборок.
+ */
+static void writeRunInfo(std::ostream& out, const RunOptions& o, uint32_t seed, size_t hw) {
+    char when[32] = "";
+    std::time_t now = std::time(nullptr);
+    std::strftime(when, sizeof when, "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    std::string kernel;
+#if defined(__unix__) || defined(__APPLE__)
+    utsname u{};
+    if (::uname(&u) == 0) kernel = std::string(u.sysname) + ' ' + u.release + ' ' + u.machine;
+#endif
+#if defined(__clang__)
+    const std::string compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+    const std::string compiler = "gcc " __VERSION__;
+#else
+    const std::string compiler = "unknown";
+#endif
+    auto list = [](const auto& v) {
+        std::string s = "[";
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (i) s += ", ";
+            if constexpr (std::is_arithmetic_v<std::decay_t<decltype(v[i])>>) s += std::to_string(v[i]);
+            else s += jsonString(v[i]);
+        }
+        return s + "]";
+    };
+    out << "{\n  \"environment\": {\"cpu\": " << jsonString(cpuModel())
+        << ", \"hardware_threads\": " << hw << ", \"kernel\": " << jsonString(kernel)
+        << ", \"compiler\": " << jsonString(compiler) << ", \"cplusplus\": " << __cplusplus
+        << ", \"flags\": " << jsonString(buildFlags()) << ", \"macros\": " << list(buildMacros())
+        << ", \"perf_counters\": " << (PerfCounters::instance().available() ? "true" : "false")
+        << ", \"time_utc\": " << jsonString(when) << "},\n"
+        << "  \"config\": {\"command\": " << jsonString(o.commandLine) << ", \"seed\": " << seed
+        << ", \"sizes\": " << list(o.sizes) << ", \"engines\": " << list(o.engines)
+        << ", \"threads\": " << list(o.threads)
+        << ", \"distribution\": " << jsonString(o.zipf == 0 ? "uniform" : "zipf")
+        << ", \"zipf_s\": " << jsonNumber(o.zipf) << ", \"hit_ratio\": " << jsonNumber(o.hitRatio)
+        << ", \"reps\": " << o.reps << "}\n}";
+}
+
+/**
+ * @brief Точка входа программы.
+ * 
+ * Генерирует данные разного размера, строит все движки IndexEngines общим
+ * measureEngine(), замеряет время построения и разрушения, память на
+ * пассажира, статистику времени поиска по набору попаданий и промахов,
+ * распределение ключей хеш-таблиц по цепочкам и двоичный снимок (запись,
+ * холодная загрузка). Затем отдельные сценарии: порядок вставки в деревья,
+ * загрузка из CSV, пропускная способность пакетного поиска на разном числе
+ * потоков, фильтр Блума при разной доле промахов, кеш горячих ключей при
+ * нагрузке Ципфа, шардированный индекс при разном числе шардов, пакетный
+ * поиск с чередованием G запросов на одном потоке, минимальная совершенная
+ * хеш-функция при разном числе корзин, запросы по диапазону и префиксу,
+ * вторичные индексы по столбцам с пересечением условий, смешанная нагрузка
+ * чтения и записи и ConcurrentHashTable при одновременных читателях и
+ * писателях.
+ * Результаты сохраняются в CSV (статистика хеш-таблиц — ещё и в JSON),
+ * окружение и параметры прогона — в run.json. Размеры, зерно, движки,
+ * потоки, распределение ключей и формат задаются параметрами (см. kUsage).
+ * 
+ * @return int Код возврата (0 — успех, 2 — неверные параметры).
+ */
+int main(int argc, char** argv) {
+    RunOptions opts;
+    try {
+        opts = parseArgs(argc, argv);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << e.what() << "\n" << kUsage;
+        return 2;
+    }
+    if (opts.help) {
+        std::cout << kUsage;
+        return 0;
+    }
+    const std::vector<size_t>& sizes = opts.sizes;
+    const uint32_t    seed = opts.seed ? *opts.seed : std::random_device{}();
+    std::mt19937      rng(seed);
+    const BenchConfig indexCfg {1'000, 3, opts.reps};
+    const BenchConfig linearCfg{16, 1, 5};  // полный проход дорог: меньше ключей и повторов
+
+    size_t hw = std::max<size_t>(1, std::thread::hardware_concurrency());
+    ThreadPool buildPool(hw);
+    // в run.json попадают движки и числа потоков, с которыми прогон действительно идёт
+    if (opts.engines.empty())
+        for (std::string_view e : engineNames(IndexEngines{})) opts.engines.emplace_back(e);
+    if (opts.sweepOnly) opts.threads.clear();     // сценариев по числу потоков не будет
+    else if (opts.threads.empty()) {
+        for (size_t t = 1; t < hw; t *= 2) opts.threads.push_back(t);
+        opts.threads.push_back(hw);
+    }
+    {
+        std::ofstream info("run.json");
+        writeRunInfo(info, opts, seed, hw);
+        info << "\n";
+    }
+    std::cout << "seed=" << seed << "\n";
+    if (!PerfCounters::instance().available())
+        std::cout << "Счётчики процессора недоступны, столбцы событий будут nan\n";
 
     std::vector<ResultRow> rows;
+    std::vector<SnapshotRow> snapRows;
 
     for (size_t n : sizes) {
 
         auto data = makeData(n, rng);
-        std::uniform_int_distribution<size_t> pick(0, n - 1);
-        std::string key = data[pick(rng)].fullName; // гарантированно существует
+        auto keys = makeWorkload(data, indexCfg.keys, opts, rng);
 
-        double tLin = timeIt([&] { linearSearch(data, key); });
+        auto tLin = benchmark([&](const std::string& k) { return linearSearch(data, k); },
+                              keys, linearCfg, rng);
+        NameColumn column(data);
+        auto tCol = benchmark([&](const std::string& k) { return column.scan(k); },
+                              keys, linearCfg, rng);
+        auto tColMt = benchmark([&](const std::string& k) { return column.scan(k, buildPool); },
+                                keys, linearCfg, rng);
+        // счётчики видят только вызывающий поток, а проход идёт на потоках пула
+        tColMt.perf = PerfCounters::none();
 
-        BST bst;
-        for (const auto& p : data) bst.insert(p);
-        double tBST = timeIt([&] { bst.search(key); });
+        // те же записи по столбцам; индексы *_row хранят RowId
+        PassengerStore store(data);
+        EngineInput input{data, store, buildPool, rng};
+        auto engines = measureEngines(IndexEngines{}, input, keys, indexCfg, opts.engines);
 
-        RBTree rbt;
-        for (const auto& p : data) rbt.insert(p);
-        double tRBT = timeIt([&] { rbt.search(key); });
+        // снимок на диске: запись, холодная загрузка и первые запросы против перестроения
+        const std::string snapPath = "passengers.snap";
+        const size_t kFirstQueries = 1'000;
+        SnapshotRow sr{.size = n};
+        sr.write = timeIt([&] { Snapshot::write(snapPath, store, rng()); });
+        dropPageCache(snapPath);
+        std::unique_ptr<Snapshot> snap;
+        sr.load = timeIt([&] { snap = std::make_unique<Snapshot>(snapPath); });
+        sr.fileBytes = snap->fileBytes();
+        sr.firstQueries = timeIt([&] {
+            for (size_t i = 0; i < kFirstQueries; ++i)
+                doNotOptimize(snap->lookup(keys[i % keys.size()]).size());
+        });
+        snap->verify();     // вне замеров: читает весь файл
+        snap.reset();
+        sr.loadWarm = timeIt([&] { snap = std::make_unique<Snapshot>(snapPath); });
+        sr.rebuild = timeIt([&] {
+            WyHashTable rebuilt(n * 2 + 1, WyHash{rng()});
+            for (const auto& p : data) rebuilt.insert(p);
+            EytzingerIndex tree(data, buildPool);
+            doNotOptimize(rebuilt.size() + tree.memoryUsage().total());
+        });
+        sr.tHash = benchmark([&](const std::string& k) { return snap->lookup(k); },
+                             keys, indexCfg, rng);
+        sr.tTree = benchmark([&](const std::string& k) { return snap->lookupTree(k); },
+                             keys, indexCfg, rng);
+        snap.reset();
+        std::remove(snapPath.c_str());
+        snapRows.push_back(sr);
 
-        HashTable ht(n * 2 + 1);
-        for (const auto& p : data) ht.insert(p);
-        double tHash = timeIt([&] { ht.search(key); });
-        size_t colls = ht.collisionCount();
-
-        std::multimap<std::string, const Passenger*> mp;
-        for (const auto& p : data) mp.emplace(p.fullName, &p);
-        double tMulti = timeIt([&] { mp.equal_range(key); });
-
-        rows.push_back({n, tLin, tBST, tRBT, tHash, tMulti, colls});
+        rows.push_back({n, tLin, tCol, tColMt, std::move(engines),
+                        passengerBytes(data), store.memoryUsage().total()});
         std::cout << "N=" << n << " done\n";
     }
-    std::ofstream csv("search_times.csv");
-    csv << "size,linear_us,bst_us,rbt_us,hash_us,multimap_us,collisions\n";
+    // Столбцы движков идут в порядке IndexEngines; набор движков у всех строк один
+    const std::vector<EngineResult>& engineCols = rows.front().engines;
+    if (opts.csv) {
+        auto writeStats = [](std::ostream& out, const BenchStats& t) {
+            out << ',' << t.min << ',' << t.median << ',' << t.p99 << ',' << t.mean << ',' << t.stddev;
+            for (double v : t.perf) out << ',' << v;
+        };
+        std::ofstream csv("search_times.csv");
+        csv << "size";
+        std::vector<const char*> timeCols{"linear", "linear_col", "linear_col_mt"};
+        for (const auto& e : engineCols) timeCols.push_back(e.name);
+        for (const char* name : timeCols) {
+            for (const char* stat : {"min", "median", "p99_single_call", "mean", "sd"})
+                csv << ',' << name << '_' << stat << "_ns";
+            for (const char* event : PerfCounters::kNames) csv << ',' << name << '_' << event;
+        }
+        for (const auto& e : engineCols) csv << ',' << e.name << "_bpp," << e.name << "_arena_bpp";
+        csv << ",data_bpp,store_bpp";
+        for (const auto& e : engineCols)
+            if (e.hasCollisions) csv << ',' << e.name << "_collisions";
+        csv << "\n";
+        for (const auto& r : rows) {
+            csv << r.size;
+            for (const BenchStats& t : {r.tLinear, r.tColumn, r.tColumnMt}) writeStats(csv, t);
+            for (const auto& e : r.engines) writeStats(csv, e.lookup);
+            for (const auto& e : r.engines)
+                csv << ',' << double(e.memory.total()) / r.size << ','
+                    << double(e.memory.arena) / r.size;
+            csv << ',' << double(r.dataBytes) / r.size << ',' << double(r.storeBytes) / r.size;
+            for (const auto& e : r.engines)
+                if (e.hasCollisions) csv << ',' << e.collisions;
+            csv << "\n";
+        }
+
+        std::ofstream bcsv("build_times.csv");
+        bcsv << "size";
+        for (const auto& e : engineCols)
+            bcsv << ',' << e.name << "_build_ns," << e.name << "_teardown_ns,"
+                 << e.name << "_bulk_build_ns," << e.name << "_max_insert_ns";
+        bcsv << "\n";
+        for (const auto& r : rows) {
+            bcsv << r.size;
+            for (const auto& e : r.engines)
+                bcsv << ',' << e.phases.build << ',' << e.phases.teardown << ','
+                     << e.bulkBuild << ',' << e.maxInsert;
+            bcsv << "\n";
+        }
+    }
+    if (opts.json) {
+        // Те же величины, что в CSV; отсутствующие (NaN) записываются как null
+        std::ofstream js("search_times.json");
+        auto stats = [&](const BenchStats& t) {
+            js << "{\"min_ns\": " << jsonNumber(t.min) << ", \"median_ns\": " << jsonNumber(t.median)
+               << ", \"p99_single_call_ns\": " << jsonNumber(t.p99) << ", \"mean_ns\": " << jsonNumber(t.mean)
+               << ", \"sd_ns\": " << jsonNumber(t.stddev);
+            for (size_t i = 0; i < t.perf.size(); ++i)
+                js << ", \"" << PerfCounters::kNames[i] << "\": " << jsonNumber(t.perf[i]);
+            js << "}";
+        };
+        js << "{\n\"run\": ";
+        writeRunInfo(js, opts, seed, hw);
+        js << ",\n\"results\": [";
+        for (size_t i = 0; i < rows.size(); ++i) {
+            const ResultRow& r = rows[i];
+            js << (i ? ",\n" : "\n") << "  {\"size\": " << r.size
+               << ", \"data_bytes_per_passenger\": " << jsonNumber(double(r.dataBytes) / r.size)
+               << ", \"store_bytes_per_passenger\": " << jsonNumber(double(r.storeBytes) / r.size)
+               << ",\n   \"linear\": ";
+            stats(r.tLinear);
+            js << ", \"linear_col\": ";
+            stats(r.tColumn);
+            js << ", \"linear_col_mt\": ";
+            stats(r.tColumnMt);
+            js << ",\n   \"engines\": [";
+            for (size_t j = 0; j < r.engines.size(); ++j) {
+                const EngineResult& e = r.engines[j];
+                js << (j ? ",\n    " : "\n    ") << "{\"name\": " << jsonString(e.name)
+                   << ", \"lookup\": ";
+                stats(e.lookup);
+                js << ", \"bytes_per_passenger\": " << jsonNumber(double(e.memory.total()) / r.size)
+                   << ", \"arena_bytes_per_passenger\": "
+                   << jsonNumber(double(e.memory.arena) / r.size)
+                   << ", \"build_ns\": " << jsonNumber(e.phases.build)
+                   << ", \"teardown_ns\": " << jsonNumber(e.phases.teardown)
+                   << ", \"bulk_build_ns\": " << jsonNumber(e.bulkBuild)
+                   << ", \"max_insert_ns\": " << jsonNumber(e.maxInsert);
+                if (e.hasCollisions) js << ", \"collisions\": " << e.collisions;
+                js << "}";
+            }
+            js << "]}";
+        }
+        js << "\n]}\n";
+    }
+
+    // Распределение по корзинам: сводка в CSV, гистограммы отдельно, всё вместе в JSON
+    std::ofstream hcsv("hash_stats.csv"), hhist("hash_chains.csv"), hjson("hash_stats.json");
+    hcsv << "size,engine,keys,buckets,load_factor,empty_buckets,collisions,max_chain,"
+            "probes_hit,probes_miss\n";
+    hhist << "size,engine,length,count\n";
+    hjson << "[";
+    const char* sep = "\n";
     for (const auto& r : rows) {
-        csv << r.size << ',' << r.tLinear << ',' << r.tBST << ','
-            << r.tRBT << ',' << r.tHash << ',' << r.tMultimap << ','
-            << r.collisions << "\n";
+        for (const auto& e : r.engines) {
+            if (!e.hashStats) continue;
+            const HashStats& h = *e.hashStats;
+            hcsv << r.size << ',' << e.name << ',' << h.keys << ',' << h.buckets << ','
+                 << h.loadFactor << ',' << h.emptyBuckets << ',' << h.collisions << ','
+                 << h.maxChain << ',' << h.avgProbesHit << ',' << h.avgProbesMiss << "\n";
+            for (size_t len = 0; len < h.histogram.size(); ++len)
+                hhist << r.size << ',' << e.name << ',' << len << ',' << h.histogram[len] << "\n";
+            hjson << sep << "  {\"size\": " << r.size << ", \"engine\": \"" << e.name
+                  << "\", \"keys\": " << h.keys << ", \"buckets\": " << h.buckets
+                  << ", \"load_factor\": " << h.loadFactor
+                  << ", \"empty_buckets\": " << h.emptyBuckets
+                  << ", \"collisions\": " << h.collisions << ", \"max_chain\": " << h.maxChain
+                  << ", \"probes_hit\": " << h.avgProbesHit
+                  << ", \"probes_miss\": " << h.avgProbesMiss << ", \"histogram\": [";
+            for (size_t len = 0; len < h.histogram.size(); ++len)
+                hjson << (len ? ", " : "") << h.histogram[len];
+            hjson << "]}";
+            sep = ",\n";
+        }
+    }
+    hjson << "\n]\n";
+
+    std::ofstream scsv("snapshot.csv");
+    scsv << "size,file_bytes,write_ns,load_ns,load_warm_ns,first_queries_ns,rebuild_ns";
+    for (const char* name : {"snap_hash", "snap_tree"})
+        for (const char* stat : {"min", "median", "p99_single_call", "mean", "sd"})
+            scsv << ',' << name << '_' << stat << "_ns";
+    scsv << "\n";
+    for (const auto& r : snapRows) {
+        scsv << r.size << ',' << r.fileBytes << ',' << r.write << ',' << r.load << ','
+             << r.loadWarm << ',' << r.firstQueries << ',' << r.rebuild;
+        for (const BenchStats& t : {r.tHash, r.tTree})
+            scsv << ',' << t.min << ',' << t.median << ',' << t.p99 << ','
+                 << t.mean << ',' << t.stddev;
+        scsv << "\n";
+    }
+    const std::string sweepFiles = std::string("run.json, ")
+        + (opts.csv ? "search_times.csv, build_times.csv, " : "")
+        + (opts.json ? "search_times.json, " : "")
+        + "hash_stats.csv, hash_chains.csv, hash_stats.json, snapshot.csv";
+    if (opts.sweepOnly) {
+        std::cout << "Результаты сохранены в " << sweepFiles << "\n";
+        return 0;
+    }
+
+    // Порядок вставки: отсортированный ввод вырождает BST в список, поэтому
+    // размеры здесь ограничены — на 1M записей цепочка стоит минут построения
+    std::vector<OrderRow> orderRows;
+    for (size_t on : {10'000, 100'000}) {
+        auto base = makeData(on, rng);
+        auto keys = makeWorkload(base, indexCfg.keys, opts, rng);
+        static const char* const orders[] = {"random", "sorted", "reverse"};
+        for (size_t o = 0; o < 3; ++o) {
+            const char* order = orders[o];
+            std::vector<Passenger> d = base;
+            if (o > 0)
+                std::stable_sort(d.begin(), d.end(), [](const Passenger& a, const Passenger& b) {
+                    return a.fullName < b.fullName;
+                });
+            if (o == 2) std::reverse(d.begin(), d.end());
+            auto measure = [&](const char* engine, auto& tree) {
+                double build = timeIt([&] { for (const auto& p : d) tree.insert(p); });
+                orderRows.push_back({on, order, engine, build, tree.height(),
+                    benchmark([&](const std::string& k) { return tree.lookup(k); },
+                              keys, indexCfg, rng)});
+            };
+            BST plain;
+            BST scapegoat(BSTBalance::Scapegoat);
+            RBTree rb;
+            measure("bst", plain);
+            measure("bst_scapegoat", scapegoat);
+            measure("rbt", rb);
+        }
+    }
+    std::ofstream ocsv("insert_order.csv");
+    ocsv << "size,order,engine,build_ns,height,median_ns,p99_single_call_ns\n";
+    for (const auto& r : orderRows)
+        ocsv << r.size << ',' << r.order << ',' << r.engine << ',' << r.build << ','
+             << r.height << ',' << r.lookup.median << ',' << r.lookup.p99 << "\n";
+
+    // Дальнейшие сценарии — на наибольшем размере, но не меньше kScenarioMinRows:
+    // на горстке записей смешанная нагрузка и шарды вырождаются
+    const size_t kScenarioMinRows = 1'000;
+    size_t n = std::max(*std::max_element(sizes.begin(), sizes.end()), kScenarioMinRows);
+    auto data = makeData(n, rng);
+
+    // Загрузка того же набора из CSV; файл каждый раз выбрасывается из кеша страниц
+    const std::string csvPath = "passengers.csv";
+    writePassengersCsv(csvPath, data);
+    std::vector<IngestRow> ingestRows;
+    auto ingest = [&](const char* mode, auto&& load) {
+        dropPageCache(csvPath);
+        CsvReader reader(csvPath);
+        double t = timeIt([&] { load(reader); });
+        ingestRows.push_back({mode, reader.rowsRead(), reader.bytesRead(), t});
+    };
+    ingest("parse", [](CsvReader& r) {
+        CsvReader::Batch b;
+        while (r.read(b)) doNotOptimize(b.rows.size());
+    });
+    ingest("store", [](CsvReader& r) {
+        PassengerStore st;
+        ingestCsv(r, st, [](RowId, RowId) {});
+    });
+    ingest("store_index_pipelined", [&](CsvReader& r) {
+        PassengerStore st;
+        RowHashTable rh(n * 2 + 1, WyHash{rng()});
+        RowRBTree rt;
+        ingestCsv(r, st, [&](RowId first, RowId last) {
+            for (RowId id = first; id < last; ++id) {
+                rh.insert(st.name(id), id);
+                rt.insert(st.name(id), id);
+            }
+        });
+    });
+    ingest("store_then_index", [&](CsvReader& r) {
+        PassengerStore st;
+        ingestCsv(r, st, [](RowId, RowId) {});
+        RowHashTable rh(n * 2 + 1, WyHash{rng()});
+        RowRBTree rt;
+        for (RowId id = 0; id < st.size(); ++id) {
+            rh.insert(st.name(id), id);
+            rt.insert(st.name(id), id);
+        }
+    });
+    std::remove(csvPath.c_str());
+    std::ofstream icsv("ingest.csv");
+    icsv << "mode,rows,bytes,time_ns,rows_per_s,mb_per_s\n";
+    for (const auto& r : ingestRows)
+        icsv << r.mode << ',' << r.rows << ',' << r.bytes << ',' << r.time << ','
+             << r.rows / (r.time * 1e-9) << ',' << r.bytes / (r.time * 1e-9) / 1e6 << "\n";
+    auto queries = makeWorkload(data, 1 << 16, opts, rng);
+    View<std::string> qv(queries);
+
+    BST bst;
+    RBTree rbt;
+    HashTable ht(n * 2 + 1);
+    WyHashTable wht(n * 2 + 1, WyHash{rng()});
+    FlatHashTable fht(n * 2 + 1, WyHash{rng()});
+    EytzingerIndex eytz(data, buildPool);
+    MultimapIndex mp;
+    RadixTrie trie;
+    for (const auto& p : data) {
+        bst.insert(p); rbt.insert(p); ht.insert(p);
+        wht.insert(p); fht.insert(p); mp.insert(p);
+        trie.insert(p);
+    }
+
+    // Пакетный поиск на 1, 2, 4, ... потоках (или на --threads)
+    const std::vector<size_t>& threadCounts = opts.threads;
+
+    std::vector<ThroughputRow> tpRows;
+    for (size_t t : threadCounts) {
+        ThreadPool pool(t);
+        tpRows.push_back({t,
+                          measureQps(bst, qv, pool), measureQps(rbt, qv, pool),
+                          measureQps(ht, qv, pool), measureQps(wht, qv, pool),
+                          measureQps(fht, qv, pool), measureQps(eytz, qv, pool),
+                          measureQps(mp, qv, pool)});
+        std::cout << "threads=" << t << " done\n";
     }
-    std::cout << "Результаты сохранены в search_times.csv\n";
+    std::ofstream tcsv("throughput.csv");
+    tcsv << "threads,bst_qps,rbt_qps,hash_qps,hash_wy_qps,flat_qps,eytz_qps,multimap_qps\n";
+    for (const auto& r : tpRows) {
+        tcsv << r.threads << ',' << r.bst << ',' << r.rbt << ',' << r.hash << ','
+             << r.wyHash << ',' << r.flat << ',' << r.eytz << ',' << r.multimap << "\n";
+    }
+
+    // Фильтр Блума перед индексами: доля промахов и размер фильтра
+    std::vector<FilterRow> filterRows;
+    for (double bits : {8.0, 12.0, 16.0}) {
+        const WyHash filterHash{rng()};
+        FilteredIndex<RBTree>         frbt(rbt, data, bits, filterHash);
+        FilteredIndex<WyHashTable>    fwht(wht, data, bits, filterHash);
+        FilteredIndex<EytzingerIndex> feytz(eytz, data, bits, filterHash);
+        const BlockedBloomFilter& bloom = frbt.bloom();
+        size_t misses = 0, falsePositives = 0;
+        for (const auto& k : makeQueries(data, 1 << 16, 0.0, rng)) {
+            if (wht.lookup(k).size()) continue;
+            ++misses;
+            falsePositives += bloom.mayContain(k);
+        }
+        const double fpr = double(falsePositives) / misses;
+        for (double hit : {1.0, 0.5, 0.1, 0.0}) {
+            auto keys = makeQueries(data, indexCfg.keys, hit, rng);
+            auto row = [&](const char* engine, const auto& plain, const auto& filtered) {
+                filterRows.push_back({bits, hit, engine, fpr, bloom.memoryUsage().total(),
+                    benchmark([&](const std::string& k) { return plain.lookup(k); },
+                              keys, indexCfg, rng),
+                    benchmark([&](const std::string& k) { return filtered.lookup(k); },
+                              keys, indexCfg, rng)});
+            };
+            row("rbt", rbt, frbt);
+            row("hash_wy", wht, fwht);
+            row("eytz", eytz, feytz);
+        }
+    }
+    std::ofstream fcsv("bloom.csv");
+    fcsv << "bits_per_key,hit_ratio,engine,fpr,filter_bpp,plain_median_ns,"
+            "plain_p99_single_call_ns,filtered_median_ns,filtered_p99_single_call_ns\n";  // filter_bpp — на пассажира
+    for (const auto& r : filterRows)
+        fcsv << r.bitsPerKey << ',' << r.hitRatio << ',' << r.engine << ',' << r.fpr << ','
+             << double(r.filterBytes) / n << ',' << r.plain.median << ',' << r.plain.p99 << ','
+             << r.filtered.median << ',' << r.filtered.p99 << "\n";
+
+    // Кеш горячих ключей при перекошенной (Ципф) нагрузке
+    std::vector<CacheRow> cacheRows;
+    const BenchConfig cacheCfg{1 << 16, 1, 3};
+    ThreadPool cachePool(hw);
+    for (double zs : {0.0, 0.99, 1.2}) {
+        auto keys = makeZipfQueries(data, cacheCfg.keys, zs, rng);
+        View<std::string> kv(keys);
+        auto rowsFor = [&](const char* engine, const auto& index) {
+            using Index = std::decay_t<decltype(index)>;
+            BenchStats plain = benchmark([&](const std::string& k) { return index.lookup(k); },
+                                         keys, cacheCfg, rng);
+            double plainQps = measureQps(index, kv, cachePool);
+            for (size_t cap : {1'024, 16'384}) {
+                CachedIndex<Index> cached(index, cap, WyHash{rng()});
+                for (const auto& k : keys) doNotOptimize(cached.lookup(k));
+                cached.resetStats();
+                for (const auto& k : keys) doNotOptimize(cached.lookup(k));
+                double hit = cached.stats().hitRate();
+                cacheRows.push_back({zs, cap, engine, hit, plain,
+                    benchmark([&](const std::string& k) { return cached.lookup(k); },
+                              keys, cacheCfg, rng),
+                    plainQps, measureQps(cached, kv, cachePool)});
+            }
+        };
+        rowsFor("bst", bst);
+        rowsFor("rbt", rbt);
+        rowsFor("hash", ht);
+        rowsFor("multimap", mp);
+    }
+    std::ofstream kcsv("cache.csv");
+    kcsv << "zipf_s,capacity,engine,hit_rate,plain_median_ns,cached_median_ns,"
+            "plain_qps,cached_qps\n";
+    for (const auto& r : cacheRows)
+        kcsv << r.zipf << ',' << r.capacity << ',' << r.engine << ',' << r.hitRate << ','
+             << r.plain.median << ',' << r.cached.median << ',' << r.plainQps << ','
+             << r.cachedQps << "\n";
+
+    // Шардирование: K индексов на своих потоках, точечный поиск, пакеты и сбор префиксов
+    std::vector<ShardRow> shardRows;
+    std::vector<std::string> prefixKeys;
+    for (const auto& k : queries) prefixKeys.push_back(k.substr(0, 3));
+    const BenchConfig prefixCfg{200, 1, 5};
+    // make(rows) создаёт пустой шард; по его типу выбирается Index
+    auto shardBench = [&](const char* engine, size_t k, auto&& make) {
+        using Index = typename decltype(make(size_t{}))::element_type;
+        std::unique_ptr<ShardedIndex<Index>> si;
+        ShardRow r{.engine = engine, .shards = k};
+        r.build = timeIt([&] {
+            si = std::make_unique<ShardedIndex<Index>>(data, k, make, WyHash{rng()});
+        });
+        r.point = benchmark([&](const std::string& key) { return si->lookup(key); },
+                            queries, indexCfg, rng);
+        std::vector<typename ShardedIndex<Index>::Result> results;
+        for (int rep = 0; rep < 3; ++rep) {
+            double t = timeIt([&] { si->lookupBatch(qv, results); });
+            r.batchQps = std::max(r.batchQps, qv.size() / (t * 1e-9));
+        }
+        if constexpr (std::is_same_v<Index, RBTree>)
+            r.prefix = benchmark([&](const std::string& p) { return si->prefixSearch(p).size(); },
+                                 prefixKeys, prefixCfg, rng);
+        shardRows.push_back(r);
+    };
+    for (size_t k : {1, 2, 4, 8}) {
+        shardBench("hash_wy", k, [&](size_t rows) {
+            return std::make_unique<WyHashTable>(rows * 2 + 1, WyHash{rng()});
+        });
+        shardBench("rbt", k, [](size_t) { return std::make_unique<RBTree>(); });
+    }
+    std::ofstream shcsv("sharding.csv");
+    shcsv << "engine,shards,build_ns,point_median_ns,batch_qps,prefix3_median_ns\n";
+    for (const auto& r : shardRows)
+        shcsv << r.engine << ',' << r.shards << ',' << r.build << ',' << r.point.median << ','
+              << r.batchQps << ',' << r.prefix.median << "\n";
+
+    // Пакетный поиск с чередованием запросов и предвыборкой на одном потоке
+    std::vector<BatchRow> batchRows;
+    auto batchBench = [&](const char* engine, const auto& index) {
+        using Result = decltype(index.lookup(std::string_view{}));
+        std::vector<Result> results(qv.size());
+        auto best = [&](auto&& pass) {
+            double t = std::numeric_limits<double>::infinity();
+            for (int rep = 0; rep < 5; ++rep) t = std::min(t, timeIt(pass));
+            doNotOptimize(results);
+            return t / qv.size();
+        };
+        double serial = best([&] {
+            for (size_t i = 0; i < qv.size(); ++i) results[i] = index.lookup(qv[i]);
+        });
+        for (size_t g : {1, 2, 4, 8, 16, 32})
+            batchRows.push_back({engine, g, serial,
+                                 best([&] { index.lookupBatch(qv, results, g); })});
+    };
+    batchBench("rbt", rbt);
+    batchBench("hash_wy", wht);
+    batchBench("hash", ht);
+    std::ofstream gcsv("batch_lookup.csv");
+    gcsv << "engine,group,serial_ns,batched_ns,speedup\n";
+    for (const auto& r : batchRows)
+        gcsv << r.engine << ',' << r.group << ',' << r.serial << ',' << r.batched << ','
+             << r.serial / r.batched << "\n";
+
+    // Минимальная совершенная хеш-функция: цена построения и размер против числа корзин
+    std::vector<PerfectRow> perfectRows;
+    for (double c : {2.0, 3.0, 4.0, 5.0, 7.0, 10.0}) {
+        std::unique_ptr<PerfectHashIndex> phf;
+        PerfectRow r{.bucketFactor = c};
+        r.build = timeIt([&] { phf = std::make_unique<PerfectHashIndex>(data, buildPool, c, rng()); });
+        r.keys       = phf->size();
+        r.attempts   = phf->buildAttempts();
+        r.bitsPerKey = phf->bitsPerKey();
+        r.lookup = benchmark([&](const std::string& k) { return phf->lookup(k); },
+                             queries, indexCfg, rng);
+        perfectRows.push_back(r);
+    }
+    std::ofstream pcsv("perfect_hash.csv");
+    pcsv << "bucket_factor,keys,build_ns,attempts,bits_per_key,median_ns,p99_single_call_ns\n";
+    for (const auto& r : perfectRows)
+        pcsv << r.bucketFactor << ',' << r.keys << ',' << r.build << ',' << r.attempts << ','
+             << r.bitsPerKey << ',' << r.lookup.median << ',' << r.lookup.p99 << "\n";
+
+    // Диапазоны и префиксы: полный проход найденного на деревьях против multimap и линейного
+    std::vector<RangeRow> rangeRows;
+    const BenchConfig rangeCfg{200, 1, 5};
+    auto countOf = [](const MultimapIndex::Range& r) {
+        return static_cast<size_t>(std::distance(r.first, r.second));
+    };
+    using RangeOp = std::function<size_t(const std::string&)>;
+    using RangeEngines = std::vector<std::pair<const char*, RangeOp>>;
+    // Линейный проход дорог и идёт по linearCfg, деревья и multimap — по rangeCfg
+    auto rangeBench = [&](const std::string& query, const std::vector<std::string>& keys,
+                          const RangeOp& linear, const RangeEngines& engines) {
+        auto run = [&](const char* engine, const RangeOp& op, const BenchConfig& cfg) {
+            std::vector<std::string> ks(keys.begin(), keys.begin() + std::min(keys.size(), cfg.keys));
+            size_t found = 0;
+            for (const auto& k : ks) found += op(k);
+            rangeRows.push_back({query, engine, double(found) / ks.size(),
+                                 benchmark(op, ks, cfg, rng)});
+        };
+        run("linear", linear, linearCfg);
+        for (const auto& [engine, op] : engines) run(engine, op, rangeCfg);
+    };
+    for (size_t len : {2, 3, 4}) {
+        std::vector<std::string> prefixes;
+        for (const auto& k : queries) prefixes.push_back(k.substr(0, len));
+        auto linear = [&](const std::string& p) {
+            size_t c = 0;
+            for (const auto& x : data) c += std::string_view(x.fullName).substr(0, p.size()) == p;
+            return c;
+        };
+        rangeBench("prefix" + std::to_string(len), prefixes, linear, RangeEngines{
+            {"bst",      [&](const std::string& p) { return bst.prefixSearch(p).count(); }},
+            {"rbt",      [&](const std::string& p) { return rbt.prefixSearch(p).count(); }},
+            {"trie",     [&](const std::string& p) { return trie.prefixSearch(p).count(); }},
+            {"multimap", [&](const std::string& p) { return countOf(mp.prefixSearch(p)); }},
+        });
+    }
+    // [p + "a", p + "m"] для трёхбуквенного p — около половины ключей с этим префиксом
+    std::vector<std::string> bases;
+    for (const auto& k : queries) bases.push_back(k.substr(0, 3));
+    auto linearRange = [&](const std::string& p) {
+        const std::string lo = p + 'a', hi = p + 'm';
+        size_t c = 0;
+        for (const auto& x : data) c += x.fullName >= lo && x.fullName <= hi;
+        return c;
+    };
+    rangeBench("range", bases, linearRange, RangeEngines{
+        {"bst",      [&](const std::string& p) { return bst.rangeSearch(p + 'a', p + 'm').count(); }},
+        {"rbt",      [&](const std::string& p) { return rbt.rangeSearch(p + 'a', p + 'm').count(); }},
+        {"multimap", [&](const std::string& p) { return countOf(mp.rangeSearch(p + 'a', p + 'm')); }},
+    });
+    std::ofstream rcsv("range_queries.csv");
+    rcsv << "query,engine,rows_per_query,min_ns,median_ns,p99_single_call_ns,mean_ns,sd_ns\n";
+    for (const auto& r : rangeRows)
+        rcsv << r.query << ',' << r.engine << ',' << r.rows << ',' << r.time.min << ','
+             << r.time.median << ',' << r.time.p99 << ',' << r.time.mean << ','
+             << r.time.stddev << "\n";
+
+    // Вторичные индексы: условия на тип каюты, номер каюты и порт против прохода по записям
+    std::vector<SecondaryRow> secondaryRows;
+    {
+        PassengerStore columns(data);
+        SecondaryIndex secondary(columns);
+        // условия запроса берутся из столбцов случайной строки
+        std::vector<RowId> sampleRows;
+        std::uniform_int_distribution<RowId> anyRow(0, static_cast<RowId>(n - 1));
+        for (size_t i = 0; i < rangeCfg.keys; ++i) sampleRows.push_back(anyRow(rng));
+        using MakeQuery = RowQuery (*)(const PassengerStore&, RowId);
+        const std::pair<const char*, MakeQuery> shapes[] = {
+            {"type", [](const PassengerStore& c, RowId r) { return RowQuery{c.cabinType(r)}; }},
+            {"port", [](const PassengerStore& c, RowId r) {
+                return RowQuery{{}, std::string(c.destinationPort(r))}; }},
+            {"port_and_type", [](const PassengerStore& c, RowId r) {
+                return RowQuery{c.cabinType(r), std::string(c.destinationPort(r))}; }},
+            {"cabin_and_type", [](const PassengerStore& c, RowId r) {
+                return RowQuery{c.cabinType(r), {}, std::pair{c.cabinNumber(r), c.cabinNumber(r)}}; }},
+            {"cabin_range_and_type", [](const PassengerStore& c, RowId r) {
+                return RowQuery{c.cabinType(r), {}, std::pair{c.cabinNumber(r), c.cabinNumber(r) + 99}}; }},
+            {"cabin_range", [](const PassengerStore& c, RowId r) {
+                return RowQuery{{}, {}, std::pair{c.cabinNumber(r), c.cabinNumber(r) + 299}}; }},
+        };
+        auto scanMatches = [](const RowQuery& q, const Passenger& p) {
+            if (q.type && parseCabinType(p.cabinType) != *q.type) return false;
+            if (q.cabins && (p.cabinNumber < q.cabins->first || p.cabinNumber > q.cabins->second))
+                return false;
+            return !q.port || p.destinationPort == *q.port;
+        };
+        for (const auto& [query, make] : shapes) {
+            // запросы строятся до замеров: в них не попадают разбор и выделение строки порта
+            std::vector<RowQuery> qs;
+            for (RowId r : sampleRows) qs.push_back(make(columns, r));
+            size_t found = 0, probes = 0;
+            for (const RowQuery& q : qs) {
+                found += secondary.count(q);
+                probes += secondary.plan(q) == SecondaryIndex::Plan::Probe;
+            }
+            SecondaryRow r{query, probes * 2 > qs.size() ? "probe" : "bitmap",
+                           double(found) / qs.size()};
+            r.index = benchmark([&](const RowQuery& q) {
+                size_t sum = 0;
+                secondary.select(q, [&](RowId row) { sum += row; });
+                return sum;
+            }, qs, rangeCfg, rng);
+            r.scan = benchmark([&](const RowQuery& q) {
+                size_t sum = 0;
+                for (size_t i = 0; i < data.size(); ++i) if (scanMatches(q, data[i])) sum += i;
+                return sum;
+            }, qs, linearCfg, rng);
+            secondaryRows.push_back(r);
+        }
+    }
+    std::ofstream qcsv("secondary.csv");
+    qcsv << "query,plan,rows_per_query,index_median_ns,index_p99_single_call_ns,"
+            "scan_median_ns,scan_p99_single_call_ns\n";
+    for (const auto& r : secondaryRows)
+        qcsv << r.query << ',' << r.plan << ',' << r.rows << ',' << r.index.median << ','
+             << r.index.p99 << ',' << r.scan.median << ',' << r.scan.p99 << "\n";
+
+    // Смешанная нагрузка на тех же структурах: поиск, удаление, вставка, замена
+    std::vector<Passenger> shadow = data;
+    auto ops = makeMixedOps(data, shadow, 200'000, rng);
+    std::vector<MixedRow> mixedRows {
+        runMixed("bst", bst, ops), runMixed("rbt", rbt, ops), runMixed("hash", ht, ops),
+        runMixed("hash_wy", wht, ops)
+    };
+    std::vector<double> timer(ops.size());
+    for (double& t : timer) t = timeIt([] {});
+    BenchStats timerStats = summarize(timer);
+
+    std::ofstream mcsv("mixed_ops.csv");
+    mcsv << "engine,op,count,min_ns,median_ns,p99_ns,mean_ns,sd_ns\n";
+    auto mixedLine = [&](const char* engine, const char* op, size_t count, const BenchStats& t) {
+        mcsv << engine << ',' << op << ',' << count << ',' << t.min << ',' << t.median << ','
+             << t.p99 << ',' << t.mean << ',' << t.stddev << "\n";
+    };
+    for (const auto& r : mixedRows) {
+        mixedLine(r.engine, "lookup", r.counts[0], r.lookup);
+        mixedLine(r.engine, "insert", r.counts[1], r.insert);
+        mixedLine(r.engine, "erase",  r.counts[2], r.erase);
+        mixedLine(r.engine, "update", r.counts[3], r.update);
+    }
+    mixedLine("timer", "empty", timer.size(), timerStats);
+
+    // Одновременные читатели и писатели
+    ConcurrentHashTable<> cht(n * 2 + 1, WyHash{rng()});
+    for (const auto& p : data) cht.insert(p);
+    std::vector<ConcurrentRow> concRows;
+    for (size_t writers : {0, 1, 2})
+        for (size_t readers : threadCounts)
+            concRows.push_back(measureConcurrent(cht, data, qv, readers, writers, 0.2, rng()));
+    std::ofstream ccsv("concurrent.csv");
+    ccsv << "readers,writers,read_qps,write_ops\n";
+    for (const auto& r : concRows)
+        ccsv << r.readers << ',' << r.writers << ',' << r.readQps << ',' << r.writeOps << "\n";
+
+    std::cout << "Результаты сохранены в " << sweepFiles << ","
+                 " insert_order.csv, ingest.csv, throughput.csv, bloom.csv, cache.csv,"
+                 " sharding.csv, batch_lookup.csv, perfect_hash.csv, range_queries.csv,"
+                 " secondary.csv, mixed_ops.csv и concurrent.csv\n";
     return 0;
 }
 